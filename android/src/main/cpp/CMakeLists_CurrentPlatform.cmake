@@ -30,6 +30,48 @@ set(CMAKE_MODULE_LINKER_FLAGS "${CMAKE_MODULE_LINKER_FLAGS} ${LINKER_FLAGS}")
 add_library(spake2 SHARED
         spake2-c/sha512.c
         spake2-c/spake2.c
+        handle_table.cpp
+        latency_histogram.cpp
         spake2_jni.cpp)
 
 target_include_directories(spake2 PUBLIC ${JAVA_HOME}/include spake2-c/include)
+
+# Native tests and benchmarks, which don't need the JDK. Build with -DSANITIZER=thread or -DSANITIZER=address and
+# run them with ctest.
+find_package(Threads REQUIRED)
+enable_testing()
+
+add_executable(handle_table_stress
+        ${CMAKE_CURRENT_SOURCE_DIR}/../../test/cpp/handle_table_stress.cpp
+        handle_table.cpp)
+
+add_executable(latency_histogram_bench
+        ${CMAKE_CURRENT_SOURCE_DIR}/../../test/cpp/latency_histogram_bench.cpp
+        latency_histogram.cpp)
+
+set(NATIVE_TESTS handle_table_stress latency_histogram_bench)
+
+# Needs mallinfo(), which macOS doesn't have
+if (NOT APPLE)
+    add_executable(context_footprint
+            ${CMAKE_CURRENT_SOURCE_DIR}/../../test/cpp/context_footprint.cpp
+            spake2-c/sha512.c
+            spake2-c/spake2.c
+            handle_table.cpp)
+
+    target_include_directories(context_footprint PRIVATE spake2-c/include)
+    list(APPEND NATIVE_TESTS context_footprint)
+endif ()
+
+foreach (test ${NATIVE_TESTS})
+    target_include_directories(${test} PRIVATE ${CMAKE_CURRENT_SOURCE_DIR})
+    target_link_libraries(${test} Threads::Threads)
+
+    if (SANITIZER)
+        set_target_properties(${test} PROPERTIES
+                COMPILE_FLAGS "-fsanitize=${SANITIZER} -fno-omit-frame-pointer -g"
+                LINK_FLAGS "-fsanitize=${SANITIZER}")
+    endif ()
+
+    add_test(NAME ${test} COMMAND ${test})
+endforeach ()
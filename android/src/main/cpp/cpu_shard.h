@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+#ifndef SPAKE2_CPU_SHARD_H
+#define SPAKE2_CPU_SHARD_H
+
+#include <sched.h>
+#include <atomic>
+
+// Index of the shard of the CPU the calling thread is running on, in [0, num_shards). Threads running on the same CPU
+// share a shard, so a shard is only contended when a thread is migrated in the middle of an operation. If the CPU
+// can't be determined, each thread is given a shard of its own in a round-robin fashion instead.
+inline unsigned cpu_shard(unsigned num_shards) {
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        return (unsigned) cpu % num_shards;
+    }
+    static std::atomic<unsigned> next_shard(0);
+    static thread_local unsigned thread_shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+    return thread_shard % num_shards;
+}
+
+#endif //SPAKE2_CPU_SHARD_H
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "cpu_shard.h"
+#include "handle_table.h"
+
+// Slots are allocated in chunks that are never freed or moved, so that lookups need no lock
+#define CHUNK_BITS 10
+#define CHUNK_SIZE (1 << CHUNK_BITS)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+#define MAX_CHUNKS 1024
+#define MAX_SLOTS ((uint32_t) MAX_CHUNKS * CHUNK_SIZE)
+
+#define NO_SLOT UINT32_MAX
+
+// Free slots are kept in one LIFO list per CPU: a slot released on a CPU is handed out again on that CPU while it is
+// still in its cache, and threads running on different CPUs never touch the same list.
+#define NUM_SHARDS 64
+
+struct slot_st {
+    // Odd while the slot is in use, even while it is free
+    std::atomic<uint32_t> generation;
+    std::atomic<struct spake2_ctx_st *> ctx;
+    // Number of threads using the context. Bumped before the generation is checked and drained by the remover after
+    // the generation is bumped, so a context is never handed out once its removal has begun nor freed while in use.
+    std::atomic<uint32_t> pins;
+    uint32_t next_free;
+};
+
+struct alignas(64) shard_st {
+    std::mutex lock;
+    // Only modified while holding the lock, but can be peeked at without it
+    std::atomic<uint32_t> free_head{NO_SLOT};
+};
+
+static std::atomic<slot_st *> chunks[MAX_CHUNKS];
+static shard_st shards[NUM_SHARDS];
+static std::mutex grow_lock;
+static uint32_t slot_count = 0;
+
+static slot_st *get_slot(uint32_t index) {
+    if (index >= MAX_SLOTS) {
+        return nullptr;
+    }
+    slot_st *chunk = chunks[index >> CHUNK_BITS].load(std::memory_order_acquire);
+    return chunk == nullptr ? nullptr : &chunk[index & CHUNK_MASK];
+}
+
+static uint32_t pop_free(shard_st *shard) {
+    if (shard->free_head.load(std::memory_order_relaxed) == NO_SLOT) {
+        return NO_SLOT;
+    }
+    std::lock_guard<std::mutex> guard(shard->lock);
+    uint32_t index = shard->free_head.load(std::memory_order_relaxed);
+    if (index != NO_SLOT) {
+        shard->free_head.store(get_slot(index)->next_free, std::memory_order_relaxed);
+    }
+    return index;
+}
+
+static void push_free(shard_st *shard, uint32_t index) {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    get_slot(index)->next_free = shard->free_head.load(std::memory_order_relaxed);
+    shard->free_head.store(index, std::memory_order_relaxed);
+}
+
+static uint32_t new_slot() {
+    std::lock_guard<std::mutex> guard(grow_lock);
+    if (slot_count == MAX_SLOTS) {
+        return NO_SLOT;
+    }
+    uint32_t index = slot_count;
+    if ((index & CHUNK_MASK) == 0) {
+        // calloc() leaves every generation counter at 0, i.e. free
+        auto chunk = (slot_st *) calloc(CHUNK_SIZE, sizeof(slot_st));
+        if (chunk == nullptr) {
+            return NO_SLOT;
+        }
+        chunks[index >> CHUNK_BITS].store(chunk, std::memory_order_release);
+    }
+    ++slot_count;
+    return index;
+}
+
+int64_t handle_table_add(struct spake2_ctx_st *ctx) {
+    // Take a slot released on this CPU, or else on the nearest CPU which has one, before growing the table
+    unsigned home = cpu_shard(NUM_SHARDS);
+    uint32_t index = NO_SLOT;
+    for (unsigned i = 0; i < NUM_SHARDS && index == NO_SLOT; ++i) {
+        index = pop_free(&shards[(home + i) % NUM_SHARDS]);
+    }
+    if (index == NO_SLOT) {
+        index = new_slot();
+        if (index == NO_SLOT) {
+            return 0;
+        }
+    }
+    slot_st *slot = get_slot(index);
+    uint32_t generation = slot->generation.load(std::memory_order_relaxed) + 1;
+    slot->ctx.store(ctx, std::memory_order_relaxed);
+    slot->generation.store(generation, std::memory_order_release);
+    return (int64_t) (((uint64_t) generation << 32) | index);
+}
+
+struct spake2_ctx_st *handle_table_acquire(int64_t handle) {
+    auto generation = (uint32_t) ((uint64_t) handle >> 32);
+    slot_st *slot = get_slot((uint32_t) handle);
+    if (slot == nullptr || (generation & 1) == 0) {
+        return nullptr;
+    }
+    // Both this and the remover store first and load second, sequentially consistent: either the remover sees the pin
+    // and waits for it, or this sees the bumped generation and backs off
+    slot->pins.fetch_add(1, std::memory_order_seq_cst);
+    if (slot->generation.load(std::memory_order_seq_cst) != generation) {
+        slot->pins.fetch_sub(1, std::memory_order_release);
+        return nullptr;
+    }
+    return slot->ctx.load(std::memory_order_relaxed);
+}
+
+void handle_table_release(int64_t handle) {
+    get_slot((uint32_t) handle)->pins.fetch_sub(1, std::memory_order_release);
+}
+
+struct spake2_ctx_st *handle_table_remove(int64_t handle) {
+    auto index = (uint32_t) handle;
+    auto generation = (uint32_t) ((uint64_t) handle >> 32);
+    slot_st *slot = get_slot(index);
+    if (slot == nullptr || (generation & 1) == 0) {
+        return nullptr;
+    }
+    // Only one of the threads removing the same handle wins, the slot is owned by it until it's back in a free list
+    uint32_t expected = generation;
+    if (!slot->generation.compare_exchange_strong(expected, generation + 1, std::memory_order_seq_cst)) {
+        return nullptr;
+    }
+    // Pins are only held for the duration of one operation on the context. Stale acquirers may bump the count
+    // briefly as well, but they back off without touching the context.
+    while (slot->pins.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+    struct spake2_ctx_st *ctx = slot->ctx.exchange(nullptr, std::memory_order_acquire);
+    push_free(&shards[cpu_shard(NUM_SHARDS)], index);
+    return ctx;
+}
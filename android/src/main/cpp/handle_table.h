@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+#ifndef SPAKE2_HANDLE_TABLE_H
+#define SPAKE2_HANDLE_TABLE_H
+
+#include <stdint.h>
+
+struct spake2_ctx_st;
+
+// Handles given to Java instead of raw context pointers. A handle is (generation << 32 | index) where index refers to
+// a slot of the native table and generation is the value of the slot's generation counter when the context was
+// added. The counter is bumped whenever the slot is released, so a stale handle never resolves to the context that
+// reuses its slot. Handles are never 0.
+
+// Adds a context to the table. Returns 0 if the table is full.
+int64_t handle_table_add(struct spake2_ctx_st *ctx);
+
+// Returns the context referred to by the handle in O(1) or nullptr if the handle is stale or invalid. Lock-free. The
+// context is pinned until handle_table_release() is called with the same handle: it can't be removed meanwhile.
+struct spake2_ctx_st *handle_table_acquire(int64_t handle);
+
+// Unpins the context returned by a successful handle_table_acquire().
+void handle_table_release(int64_t handle);
+
+// Invalidates the handle and returns its slot to the free list, or does nothing if the handle is stale or invalid.
+// Waits for every thread that pinned the context to release it. Returns the context that the handle referred to, which
+// is owned by the caller from then on, or nullptr. Must not be called by a thread which has the context pinned.
+struct spake2_ctx_st *handle_table_remove(int64_t handle);
+
+#endif //SPAKE2_HANDLE_TABLE_H
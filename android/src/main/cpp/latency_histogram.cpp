@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+
+#include "cpu_shard.h"
+#include "latency_histogram.h"
+
+// Log-linear buckets laid out exactly like an HdrHistogram with lowestDiscernibleValue = 1,
+// highestTrackableValue = HIGHEST_TRACKABLE_VALUE and numberOfSignificantValueDigits = SIGNIFICANT_DIGITS so that the
+// counts can be encoded without any conversion.
+#define SIGNIFICANT_DIGITS 1
+#define SUB_BUCKET_COUNT_MAGNITUDE 5  // ceil(log2(2 * 10^SIGNIFICANT_DIGITS))
+#define SUB_BUCKET_HALF_COUNT_MAGNITUDE (SUB_BUCKET_COUNT_MAGNITUDE - 1)
+#define SUB_BUCKET_COUNT (1 << SUB_BUCKET_COUNT_MAGNITUDE)
+#define SUB_BUCKET_HALF_COUNT (1 << SUB_BUCKET_HALF_COUNT_MAGNITUDE)
+#define SUB_BUCKET_MASK ((uint64_t) SUB_BUCKET_COUNT - 1)
+#define LEADING_ZERO_COUNT_BASE (64 - SUB_BUCKET_COUNT_MAGNITUDE)
+#define HIGHEST_TRACKABLE_VALUE 10000000000ULL  // 10 seconds
+#define BUCKET_COUNT 30  // Smallest n such that SUB_BUCKET_COUNT * 2^(n-1) > HIGHEST_TRACKABLE_VALUE
+#define COUNTS_LEN ((BUCKET_COUNT + 1) << SUB_BUCKET_HALF_COUNT_MAGNITUDE)
+
+// One shard per configured CPU, up to MAX_SHARDS CPUs, so that concurrent recordings don't bounce the same cache
+// lines. A shard takes about 32 KiB and is only allocated once a thread records on its CPU.
+#define MAX_SHARDS 256
+
+#define V2_ENCODING_COOKIE 0x1c849313
+#define HEADER_SIZE 40
+#define MAX_LEB128_SIZE 9
+
+const size_t LATENCY_HISTOGRAM_MAX_ENCODED_SIZE = HEADER_SIZE + COUNTS_LEN * MAX_LEB128_SIZE;
+
+struct alignas(64) shard_st {
+    std::atomic<uint64_t> counts[latency_metric_count][COUNTS_LEN];
+};
+
+static std::atomic<shard_st *> shards[MAX_SHARDS];
+static std::atomic<unsigned> shard_count(0);
+
+static unsigned get_shard_count() {
+    unsigned count = shard_count.load(std::memory_order_relaxed);
+    if (count == 0) {
+        // Racing threads compute the same value
+        long cpus = sysconf(_SC_NPROCESSORS_CONF);
+        count = cpus < 1 ? 1 : (cpus > MAX_SHARDS ? MAX_SHARDS : (unsigned) cpus);
+        shard_count.store(count, std::memory_order_relaxed);
+    }
+    return count;
+}
+
+static shard_st *get_shard(unsigned index) {
+    shard_st *shard = shards[index].load(std::memory_order_acquire);
+    if (shard != nullptr) {
+        return shard;
+    }
+    void *mem;
+    if (posix_memalign(&mem, alignof(shard_st), sizeof(shard_st)) != 0) {
+        return nullptr;
+    }
+    memset(mem, 0, sizeof(shard_st));
+    if (!shards[index].compare_exchange_strong(shard, (shard_st *) mem, std::memory_order_acq_rel)) {
+        // Another thread on the same CPU got there first
+        free(mem);
+        return shard;
+    }
+    return (shard_st *) mem;
+}
+
+static int counts_index(uint64_t value) {
+    int bucket_index = LEADING_ZERO_COUNT_BASE - __builtin_clzll(value | SUB_BUCKET_MASK);
+    int sub_bucket_index = (int) (value >> bucket_index);
+    return ((bucket_index + 1) << SUB_BUCKET_HALF_COUNT_MAGNITUDE) + (sub_bucket_index - SUB_BUCKET_HALF_COUNT);
+}
+
+uint64_t latency_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void latency_record(latency_metric_t metric, uint64_t nanos) {
+    if (nanos > HIGHEST_TRACKABLE_VALUE) {
+        nanos = HIGHEST_TRACKABLE_VALUE;
+    }
+    // Looking up the CPU is only worth it when recordings can contend
+    unsigned count = get_shard_count();
+    shard_st *shard = get_shard(count == 1 ? 0 : cpu_shard(count));
+    if (shard == nullptr) {
+        // Out of memory, drop the sample
+        return;
+    }
+    shard->counts[metric][counts_index(nanos)].fetch_add(1, std::memory_order_relaxed);
+}
+
+static uint8_t *put_int_be(uint8_t *out, uint32_t value) {
+    for (int i = 3; i >= 0; --i) {
+        *out++ = (uint8_t) (value >> (8 * i));
+    }
+    return out;
+}
+
+static uint8_t *put_long_be(uint8_t *out, uint64_t value) {
+    for (int i = 7; i >= 0; --i) {
+        *out++ = (uint8_t) (value >> (8 * i));
+    }
+    return out;
+}
+
+// ZigZag followed by LEB128-64b9B, same as org.HdrHistogram.ZigZagEncoding.putLong()
+static uint8_t *put_zigzag(uint8_t *out, int64_t signed_value) {
+    uint64_t value = ((uint64_t) signed_value << 1) ^ (uint64_t) (signed_value >> 63);
+    for (int i = 0; i < 8; ++i) {
+        if ((value >> (7 * (i + 1))) == 0) {
+            *out++ = (uint8_t) (value >> (7 * i));
+            return out;
+        }
+        *out++ = (uint8_t) (((value >> (7 * i)) & 0x7F) | 0x80);
+    }
+    *out++ = (uint8_t) (value >> 56);
+    return out;
+}
+
+size_t latency_encode(latency_metric_t metric, uint8_t *out) {
+    uint64_t counts[COUNTS_LEN];
+    memset(counts, 0, sizeof(counts));
+    for (int s = 0; s < MAX_SHARDS; ++s) {
+        shard_st *shard = shards[s].load(std::memory_order_acquire);
+        if (shard == nullptr) {
+            continue;
+        }
+        for (int i = 0; i < COUNTS_LEN; ++i) {
+            counts[i] += shard->counts[metric][i].load(std::memory_order_relaxed);
+        }
+    }
+    int counts_limit = COUNTS_LEN;
+    while (counts_limit > 0 && counts[counts_limit - 1] == 0) {
+        --counts_limit;
+    }
+
+    uint8_t *p = out;
+    p = put_int_be(p, V2_ENCODING_COOKIE);
+    p = put_int_be(p, 0);  // Payload length, filled below
+    p = put_int_be(p, 0);  // Normalizing index offset
+    p = put_int_be(p, SIGNIFICANT_DIGITS);
+    p = put_long_be(p, 1);  // Lowest discernible value
+    p = put_long_be(p, HIGHEST_TRACKABLE_VALUE);
+    p = put_long_be(p, 0x3FF0000000000000ULL);  // Integer to double value conversion ratio, 1.0
+    uint8_t *payload = p;
+
+    // Runs of zeros are encoded as a negative count
+    int i = 0;
+    while (i < counts_limit) {
+        uint64_t count = counts[i++];
+        if (count == 0) {
+            int64_t zeros = 1;
+            while (i < counts_limit && counts[i] == 0) {
+                ++zeros;
+                ++i;
+            }
+            p = put_zigzag(p, zeros > 1 ? -zeros : 0);
+        } else {
+            p = put_zigzag(p, (int64_t) count);
+        }
+    }
+    put_int_be(out + 4, (uint32_t) (p - payload));
+    return (size_t) (p - out);
+}
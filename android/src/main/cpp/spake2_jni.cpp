@@ -10,11 +10,15 @@
 
 #include <spake2/spake2.h>
 
+#include "handle_table.h"
+#include "latency_histogram.h"
+
 #ifndef nullptr
 #define nullptr NULL
 #endif
 
 static jlong Spake2Context_AllocNewContext(JNIEnv *env, jclass clazz, jint myRole, jbyteArray myName, jbyteArray theirName) {
+    uint64_t start = latency_now();
     spake2_role_t my_role = myRole == 0 ? spake2_role_alice : spake2_role_bob;
     auto my_len = env->GetArrayLength(myName);
     auto my_name = env->GetByteArrayElements(myName, nullptr);
@@ -24,52 +28,128 @@ static jlong Spake2Context_AllocNewContext(JNIEnv *env, jclass clazz, jint myRol
     struct spake2_ctx_st *ctx = SPAKE2_CTX_new(my_role, (uint8_t *) my_name, my_len, (uint8_t *) their_name, their_len);
     env->ReleaseByteArrayElements(myName, my_name, 0);
     env->ReleaseByteArrayElements(theirName, their_name, 0);
+    uint64_t end = latency_now();
     if (ctx == nullptr) {
         printf("Couldn't create SPAKE2 context");
         return 0;
     }
-    return (jlong) ctx;
+    jlong handle = handle_table_add(ctx);
+    if (handle == 0) {
+        printf("Too many SPAKE2 contexts");
+        SPAKE2_CTX_free(ctx);
+        return 0;
+    }
+    latency_record(latency_alloc, end - start);
+    return handle;
 }
 
-static jbyteArray Spake2Context_GenerateMessage(JNIEnv *env, jclass clazz, jlong ctxPtr, jbyteArray password) {
-    struct spake2_ctx_st *ctx = (struct spake2_ctx_st *) ctxPtr;
+static jbyteArray Spake2Context_GenerateMessage(JNIEnv *env, jclass clazz, jlong handle, jbyteArray password) {
+    uint64_t start = latency_now();
+    struct spake2_ctx_st *ctx = handle_table_acquire(handle);
+    if (ctx == nullptr) {
+        printf("Invalid SPAKE2 context");
+        return nullptr;
+    }
     auto pswd_size = env->GetArrayLength(password);
     auto pswd = env->GetByteArrayElements(password, nullptr);
     size_t msg_size = 0;
     uint8_t msg[SPAKE2_MAX_MSG_SIZE];
+    uint64_t compute_start = latency_now();
     int status = SPAKE2_generate_msg(ctx, msg, &msg_size, SPAKE2_MAX_MSG_SIZE, (uint8_t *) pswd, pswd_size);
+    uint64_t compute_end = latency_now();
+    handle_table_release(handle);
     env->ReleaseByteArrayElements(password, pswd, 0);
     if (status != 1 || msg_size == 0) {
         printf("Couldn't generate message");
-        SPAKE2_CTX_free(ctx);
+        // A concurrent destroy() may have removed it already
+        ctx = handle_table_remove(handle);
+        if (ctx != nullptr) {
+            SPAKE2_CTX_free(ctx);
+        }
         return nullptr;
     }
     jbyteArray outMsg = env->NewByteArray(msg_size);
     env->SetByteArrayRegion(outMsg, 0, msg_size, (jbyte *) msg);
+    uint64_t end = latency_now();
+    latency_record(latency_generate_compute, compute_end - compute_start);
+    latency_record(latency_generate_marshal, (end - start) - (compute_end - compute_start));
+    latency_record(latency_generate, end - start);
     return outMsg;
 }
 
-static jbyteArray Spake2Context_ProcessMessage(JNIEnv *env, jclass clazz, jlong ctxPtr, jbyteArray theirMessage) {
-    struct spake2_ctx_st *ctx = (struct spake2_ctx_st *) ctxPtr;
+static jbyteArray Spake2Context_ProcessMessage(JNIEnv *env, jclass clazz, jlong handle, jbyteArray theirMessage) {
+    uint64_t start = latency_now();
+    struct spake2_ctx_st *ctx = handle_table_acquire(handle);
+    if (ctx == nullptr) {
+        printf("Invalid SPAKE2 context");
+        return nullptr;
+    }
     auto their_msg_len = env->GetArrayLength(theirMessage);
     auto their_msg = env->GetByteArrayElements(theirMessage, nullptr);
     size_t key_material_len = 0;
     uint8_t key_material[SPAKE2_MAX_KEY_SIZE];
+    uint64_t compute_start = latency_now();
     int status = SPAKE2_process_msg(ctx, key_material, &key_material_len, SPAKE2_MAX_KEY_SIZE, (uint8_t *) their_msg, their_msg_len);
+    uint64_t compute_end = latency_now();
+    handle_table_release(handle);
     env->ReleaseByteArrayElements(theirMessage, their_msg, 0);
     if (status != 1 || key_material_len == 0) {
         printf("Couldn't generate key");
-        SPAKE2_CTX_free(ctx);
+        // A concurrent destroy() may have removed it already
+        ctx = handle_table_remove(handle);
+        if (ctx != nullptr) {
+            SPAKE2_CTX_free(ctx);
+        }
         return nullptr;
     }
     jbyteArray outKey = env->NewByteArray(key_material_len);
     env->SetByteArrayRegion(outKey, 0, key_material_len, (jbyte *) key_material);
+    uint64_t end = latency_now();
+    latency_record(latency_process_compute, compute_end - compute_start);
+    latency_record(latency_process_marshal, (end - start) - (compute_end - compute_start));
+    latency_record(latency_process, end - start);
     return outKey;
 }
 
-static void Spake2Context_Destroy(JNIEnv *env, jclass clazz, jlong ctxPtr) {
-    struct spake2_ctx_st *ctx = (struct spake2_ctx_st *) ctxPtr;
+static void Spake2Context_Destroy(JNIEnv *env, jclass clazz, jlong handle) {
+    uint64_t start = latency_now();
+    struct spake2_ctx_st *ctx = handle_table_remove(handle);
+    if (ctx == nullptr) {
+        // Already destroyed
+        return;
+    }
     SPAKE2_CTX_free(ctx);
+    latency_record(latency_destroy, latency_now() - start);
+}
+
+static jobjectArray Spake2Context_SnapshotHistograms(JNIEnv *env, jclass clazz) {
+    jclass byteArrayClass = env->FindClass("[B");
+    if (byteArrayClass == nullptr) {
+        return nullptr;
+    }
+    jobjectArray histograms = env->NewObjectArray(latency_metric_count, byteArrayClass, nullptr);
+    if (histograms == nullptr) {
+        return nullptr;
+    }
+    auto encoded = (uint8_t *) malloc(LATENCY_HISTOGRAM_MAX_ENCODED_SIZE);
+    if (encoded == nullptr) {
+        env->ThrowNew(env->FindClass("java/lang/OutOfMemoryError"), "Couldn't allocate the histogram buffer");
+        return nullptr;
+    }
+    for (int i = 0; i < latency_metric_count; ++i) {
+        size_t len = latency_encode((latency_metric_t) i, encoded);
+        jbyteArray histogram = env->NewByteArray(len);
+        if (histogram == nullptr) {
+            // OutOfMemoryError is pending
+            free(encoded);
+            return nullptr;
+        }
+        env->SetByteArrayRegion(histogram, 0, len, (jbyte *) encoded);
+        env->SetObjectArrayElement(histograms, i, histogram);
+        env->DeleteLocalRef(histogram);
+    }
+    free(encoded);
+    return histograms;
 }
 
 JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
@@ -83,6 +163,7 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
             {"generateMessage", "(J[B)[B",  (void *) Spake2Context_GenerateMessage},
             {"processMessage",  "(J[B)[B",  (void *) Spake2Context_ProcessMessage},
             {"destroy",         "(J)V",     (void *) Spake2Context_Destroy},
+            {"snapshotHistograms", "()[[B", (void *) Spake2Context_SnapshotHistograms},
     };
 
     env->RegisterNatives(env->FindClass("io/github/muntashirakon/crypto/spake2/Spake2Context"), methods_Spake2Context,
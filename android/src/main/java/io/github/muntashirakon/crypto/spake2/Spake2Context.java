@@ -25,6 +25,43 @@ public class Spake2Context implements Destroyable {
      */
     public static final int MAX_KEY_SIZE = 64;
 
+    // Indices of the latency histograms returned by snapshotHistograms()
+    /**
+     * Time spent allocating a native context, recorded only for successful allocations
+     */
+    public static final int HISTOGRAM_ALLOC = 0;
+    /**
+     * Total time spent generating a message
+     */
+    public static final int HISTOGRAM_GENERATE = 1;
+    /**
+     * Total time spent processing a message
+     */
+    public static final int HISTOGRAM_PROCESS = 2;
+    /**
+     * Time spent destroying a native context
+     */
+    public static final int HISTOGRAM_DESTROY = 3;
+    /**
+     * Time spent copying the arguments and the result of {@link #generateMessage(byte[])} between Java and native
+     */
+    public static final int HISTOGRAM_GENERATE_MARSHAL = 4;
+    /**
+     * Time spent in {@code SPAKE2_generate_msg}
+     */
+    public static final int HISTOGRAM_GENERATE_COMPUTE = 5;
+    /**
+     * Time spent copying the arguments and the result of {@link #processMessage(byte[])} between Java and native
+     */
+    public static final int HISTOGRAM_PROCESS_MARSHAL = 6;
+    /**
+     * Time spent in {@code SPAKE2_process_msg}
+     */
+    public static final int HISTOGRAM_PROCESS_COMPUTE = 7;
+
+    /**
+     * Generation-tagged handle to the native context, it becomes stale as soon as the context is destroyed
+     */
     private final long mCtx;
 
     private final byte[] mMyMsg = new byte[MAX_MSG_SIZE];
@@ -78,6 +115,22 @@ public class Spake2Context implements Destroyable {
         destroy(mCtx);
     }
 
+    /**
+     * Take a snapshot of the latency histograms of all contexts since the library was loaded. Latencies are recorded
+     * in nanoseconds.
+     *
+     * @return Histograms indexed by {@code HISTOGRAM_*}, each encoded in the HdrHistogram V2 format, i.e. they can be
+     * read using {@code org.HdrHistogram.Histogram.decodeFromByteBuffer(ByteBuffer.wrap(bytes), 0)}.
+     */
+    @NonNull
+    public static byte[][] getLatencyHistograms() {
+        byte[][] histograms = snapshotHistograms();
+        if (histograms == null) {
+            throw new IllegalStateException("Could not take a snapshot of the histograms");
+        }
+        return histograms;
+    }
+
     private static native long allocNewContext(int myRole, byte[] myName, byte[] theirName);
 
     @Nullable
@@ -87,4 +140,7 @@ public class Spake2Context implements Destroyable {
     private static native byte[] processMessage(long ctx, byte[] theirMessage);
 
     private static native void destroy(long ctx);
+
+    @Nullable
+    private static native byte[][] snapshotHistograms();
 }
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+// Bytes per live native context, i.e. what a handle given to Java costs: the SPAKE2 context allocated by spake2-c and
+// its slot in the handle table. Measured as the growth of the malloc heap while keeping many contexts alive.
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <spake2/spake2.h>
+
+#include "handle_table.h"
+
+#define NUM_CONTEXTS 100000
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while (0)
+
+static size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return (size_t) mallinfo().uordblks;
+#endif
+}
+
+int main() {
+    const char *my_name = "adb pair client";
+    const char *their_name = "adb pair server";
+    // Reserved up front so that only the contexts and the table are measured
+    std::vector<int64_t> handles;
+    handles.reserve(NUM_CONTEXTS);
+
+    size_t before = heap_in_use();
+    for (int i = 0; i < NUM_CONTEXTS; ++i) {
+        struct spake2_ctx_st *ctx = SPAKE2_CTX_new(spake2_role_alice, (const uint8_t *) my_name, strlen(my_name) + 1,
+                                                   (const uint8_t *) their_name, strlen(their_name) + 1);
+        CHECK(ctx != nullptr);
+        int64_t handle = handle_table_add(ctx);
+        CHECK(handle != 0);
+        handles.push_back(handle);
+    }
+    size_t after = heap_in_use();
+    if (after <= before) {
+        // e.g. under a sanitizer, which replaces malloc()
+        printf("Heap usage is not available\n");
+    } else {
+        printf("%zu bytes per live context\n", (after - before) / NUM_CONTEXTS);
+    }
+
+    for (int64_t handle : handles) {
+        struct spake2_ctx_st *ctx = handle_table_remove(handle);
+        CHECK(ctx != nullptr);
+        SPAKE2_CTX_free(ctx);
+    }
+    // The slots are kept for reuse, but the contexts must all be gone
+    if (after > before) {
+        printf("%zu bytes kept by the handle table\n", heap_in_use() - before);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+// Hammers the handle table from several threads which add, use and remove contexts behind each other's backs. Meant
+// to be run under ThreadSanitizer or AddressSanitizer (see CMakeLists_CurrentPlatform.cmake): a context used after it
+// was freed, freed twice or resolved through a stale handle is reported by the sanitizer or by the checks below.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "handle_table.h"
+
+#define NUM_THREADS 8
+#define NUM_SHARED 64
+#define ITERATIONS 200000
+#define MAGIC 0x5350414b45320000ULL
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while (0)
+
+// Stands in for the SPAKE2 context, which is opaque to the table
+struct spake2_ctx_st {
+    // Plain field: a read racing with free() is what the sanitizers look for
+    uint64_t magic;
+    // The handle the context was added with, 0 until the adder publishes it
+    std::atomic<int64_t> handle;
+    std::atomic<uint64_t> uses;
+};
+
+static std::atomic<int64_t> shared_handles[NUM_SHARED];
+static std::atomic<uint64_t> added(0);
+static std::atomic<uint64_t> freed(0);
+
+static struct spake2_ctx_st *new_ctx() {
+    auto ctx = new spake2_ctx_st();
+    ctx->magic = MAGIC;
+    return ctx;
+}
+
+static void free_ctx(struct spake2_ctx_st *ctx) {
+    CHECK(ctx->magic == MAGIC);
+    ctx->magic = 0;
+    delete ctx;
+    freed.fetch_add(1, std::memory_order_relaxed);
+}
+
+static int64_t add(struct spake2_ctx_st *ctx) {
+    int64_t handle = handle_table_add(ctx);
+    CHECK(handle != 0);
+    ctx->handle.store(handle, std::memory_order_release);
+    added.fetch_add(1, std::memory_order_relaxed);
+    return handle;
+}
+
+static void use(int64_t handle) {
+    struct spake2_ctx_st *ctx = handle_table_acquire(handle);
+    if (ctx == nullptr) {
+        return;
+    }
+    CHECK(ctx->magic == MAGIC);
+    int64_t owner = ctx->handle.load(std::memory_order_acquire);
+    // A stale handle must never resolve to the context which reuses its slot
+    CHECK(owner == 0 || owner == handle);
+    ctx->uses.fetch_add(1, std::memory_order_relaxed);
+    std::this_thread::yield();
+    CHECK(ctx->magic == MAGIC);
+    handle_table_release(handle);
+}
+
+static void remove(int64_t handle) {
+    struct spake2_ctx_st *ctx = handle_table_remove(handle);
+    if (ctx != nullptr) {
+        free_ctx(ctx);
+    }
+}
+
+static void run(unsigned seed) {
+    uint32_t x = seed * 2654435761U + 1;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        std::atomic<int64_t> &entry = shared_handles[x % NUM_SHARED];
+        switch ((x >> 8) % 4) {
+            case 0: {
+                // Replace: other threads may still be using or removing the old handle
+                int64_t old = entry.exchange(add(new_ctx()), std::memory_order_acq_rel);
+                remove(old);
+                break;
+            }
+            case 1:
+                // Remove without forgetting the handle, so it goes stale while others keep using and removing it
+                remove(entry.load(std::memory_order_acquire));
+                break;
+            default:
+                use(entry.load(std::memory_order_acquire));
+                break;
+        }
+    }
+}
+
+int main() {
+    for (auto &entry : shared_handles) {
+        entry.store(add(new_ctx()), std::memory_order_relaxed);
+    }
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < NUM_THREADS; ++i) {
+        threads.emplace_back(run, i);
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (auto &entry : shared_handles) {
+        int64_t handle = entry.load(std::memory_order_relaxed);
+        remove(handle);
+        CHECK(handle_table_acquire(handle) == nullptr);
+        CHECK(handle_table_remove(handle) == nullptr);
+    }
+    CHECK(added.load() == freed.load());
+    printf("%llu contexts added and freed\n", (unsigned long long) added.load());
+    return 0;
+}
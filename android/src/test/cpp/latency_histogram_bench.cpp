@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+// Records from 1, 2, 4, ... threads up to the number of CPUs (or the number given as the first argument), and
+// compares the cost of a recording against a single histogram shared by all threads, which is what the shards are
+// meant to avoid. Also checks that the merged and encoded histogram holds every recording. latency_record() is called
+// directly, so the numbers don't include the JNI transitions around the timed operations.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "latency_histogram.h"
+
+#define RECORDS_PER_THREAD 2000000
+#define SHARED_COUNTS_LEN 496
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        abort(); \
+    } \
+} while (0)
+
+static std::atomic<uint64_t> shared_counts[SHARED_COUNTS_LEN];
+
+static uint32_t get_int_be(const uint8_t *in) {
+    return (uint32_t) in[0] << 24 | (uint32_t) in[1] << 16 | (uint32_t) in[2] << 8 | in[3];
+}
+
+// Inverse of put_zigzag() in latency_histogram.cpp
+static const uint8_t *get_zigzag(const uint8_t *in, int64_t *signed_value) {
+    uint64_t value = 0;
+    int i = 0;
+    for (; i < 8; ++i) {
+        value |= (uint64_t) (in[i] & 0x7F) << (7 * i);
+        if ((in[i] & 0x80) == 0) {
+            break;
+        }
+    }
+    if (i == 8) {
+        value |= (uint64_t) in[i] << 56;
+    }
+    *signed_value = (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+    return in + i + 1;
+}
+
+static uint64_t total_count(latency_metric_t metric) {
+    std::vector<uint8_t> encoded(LATENCY_HISTOGRAM_MAX_ENCODED_SIZE);
+    size_t len = latency_encode(metric, encoded.data());
+    CHECK(len >= 40 && get_int_be(&encoded[0]) == 0x1c849313);
+    CHECK(get_int_be(&encoded[4]) == len - 40);
+    uint64_t total = 0;
+    const uint8_t *p = &encoded[40];
+    while (p < encoded.data() + len) {
+        int64_t count;
+        p = get_zigzag(p, &count);
+        if (count > 0) {
+            total += (uint64_t) count;
+        }
+    }
+    CHECK(p == encoded.data() + len);
+    return total;
+}
+
+template<typename Record>
+static double ns_per_record(unsigned num_threads, Record record) {
+    std::vector<std::thread> threads;
+    uint64_t start = latency_now();
+    for (unsigned t = 0; t < num_threads; ++t) {
+        threads.emplace_back([t, record]() {
+            for (uint64_t i = 0; i < RECORDS_PER_THREAD; ++i) {
+                // Spread over the buckets the way handshake latencies would
+                record(20000 + ((i * 2654435761U + t) & 0xFFFF));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    // Wall time of a recording on one thread
+    return (double) (latency_now() - start) / RECORDS_PER_THREAD;
+}
+
+int main(int argc, char **argv) {
+    unsigned cpus = argc > 1 ? (unsigned) atoi(argv[1]) : std::thread::hardware_concurrency();
+    if (cpus == 0) {
+        cpus = 1;
+    }
+    uint64_t expected = 0;
+    printf("threads  sharded ns/record  shared ns/record\n");
+    for (unsigned n = 1;; n = n * 2 > cpus ? cpus : n * 2) {
+        double sharded = ns_per_record(n, [](uint64_t nanos) {
+            latency_record(latency_generate, nanos);
+        });
+        double shared = ns_per_record(n, [](uint64_t nanos) {
+            shared_counts[nanos % SHARED_COUNTS_LEN].fetch_add(1, std::memory_order_relaxed);
+        });
+        printf("%7u  %17.1f  %16.1f\n", n, sharded, shared);
+        expected += (uint64_t) n * RECORDS_PER_THREAD;
+        CHECK(total_count(latency_generate) == expected);
+        if (n == cpus) {
+            break;
+        }
+    }
+    CHECK(total_count(latency_process) == 0);
+    return 0;
+}
@@ -6,8 +6,10 @@
 
 package io.github.muntashirakon.crypto.spake2;
 
+import org.HdrHistogram.Histogram;
 import org.junit.Test;
 
+import java.nio.ByteBuffer;
 import java.nio.charset.StandardCharsets;
 import java.util.Arrays;
 
@@ -74,6 +76,35 @@ public class Spake2ContextTest {
         }
     }
 
+    @Test
+    public void latencyHistograms() {
+        for (int i = 0; i < 4; i++) {
+            SPAKE2Run spake2 = new SPAKE2Run();
+            assertTrue(spake2.run());
+        }
+        byte[][] histograms = Spake2Context.getLatencyHistograms();
+        assertEquals(Spake2Context.HISTOGRAM_PROCESS_COMPUTE + 1, histograms.length);
+        for (byte[] encoded : histograms) {
+            // Decoded by HdrHistogram, and the same once encoded by HdrHistogram again
+            Histogram histogram = Histogram.decodeFromByteBuffer(ByteBuffer.wrap(encoded), 0);
+            assertEquals(1, histogram.getLowestDiscernibleValue());
+            assertEquals(10_000_000_000L, histogram.getHighestTrackableValue());
+            ByteBuffer buffer = ByteBuffer.allocate(histogram.getNeededByteBufferCapacity());
+            histogram.encodeIntoByteBuffer(buffer);
+            buffer.flip();
+            assertEquals(histogram, Histogram.decodeFromByteBuffer(buffer, 0));
+        }
+        // Two messages are generated and processed in each run
+        Histogram generate = Histogram.decodeFromByteBuffer(
+                ByteBuffer.wrap(histograms[Spake2Context.HISTOGRAM_GENERATE]), 0);
+        Histogram generateCompute = Histogram.decodeFromByteBuffer(
+                ByteBuffer.wrap(histograms[Spake2Context.HISTOGRAM_GENERATE_COMPUTE]), 0);
+        assertTrue(generate.getTotalCount() >= 8);
+        assertEquals(generate.getTotalCount(), generateCompute.getTotalCount());
+        assertTrue(generate.getValueAtPercentile(99) > 0);
+        assertTrue(generate.getMaxValue() >= generateCompute.getMinValue());
+    }
+
     // Based on https://android.googlesource.com/platform/external/boringssl/+/f9e0b0e17fabac35627f18f94a8954c3857784ac/src/crypto/curve25519/spake25519_test.cc
     private static class SPAKE2Run {
         private final Pair<String, String> aliceNames = new Pair<>("adb pair client\u0000", "adb pair server\u0000");
@@ -7,6 +7,7 @@
 package io.github.muntashirakon.crypto.ed25519;
 
 import java.io.Serializable;
+import java.nio.ByteBuffer;
 
 /**
  * A twisted Edwards curve.
@@ -74,7 +75,17 @@ public class Curve implements Serializable {
     }
 
     public GroupElement fromBytesNegateVarTime(final byte[] s) {
-        FieldElement Y = f.fromByteArray(s);
+        return fromBytesNegateVarTime(ByteBuffer.wrap(s), 0);
+    }
+
+    /**
+     * Same as {@link #fromBytesNegateVarTime(byte[])}, but reads the encoded point from a heap or direct buffer in
+     * place. The position of the buffer is not changed.
+     *
+     * @param off Absolute offset of the encoded point.
+     */
+    public GroupElement fromBytesNegateVarTime(final ByteBuffer s, int off) {
+        FieldElement Y = f.fromByteBuffer(s, off);
         FieldElement Z = f.ONE;
         FieldElement y2 = Y.square();
         FieldElement dy2 = y2.multiply(d);
@@ -98,7 +109,7 @@ public class Curve implements Serializable {
         }
 
         int isNegative = X.isNegative() ? 1 : 0;
-        if (isNegative != (s[31] >>> 7)) {
+        if (isNegative != (s.get(off + 31) >>> 7)) {
             X = X.negate(); // x = -iuv^3(uv^7)^((q-5)/8)
         }
 
@@ -7,6 +7,7 @@
 package io.github.muntashirakon.crypto.ed25519;
 
 import java.io.Serializable;
+import java.nio.ByteBuffer;
 
 /**
  * An Ed25519 finite field. Includes several pre-computed values.
@@ -64,6 +65,10 @@ public class Ed25519Field implements Serializable {
         return enc.decode(x);
     }
 
+    public FieldElement fromByteBuffer(ByteBuffer x, int off) {
+        return enc.decode(x, off);
+    }
+
     public int getb() {
         return b;
     }
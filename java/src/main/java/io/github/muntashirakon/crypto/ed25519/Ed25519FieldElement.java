@@ -167,6 +167,7 @@ public class Ed25519FieldElement extends FieldElement {
      * @return The (reasonably reduced) field element this * val.
      */
     public FieldElement multiply(FieldElement val) {
+        if (KernelProfiler.ENABLED) KernelProfiler.count(KernelProfiler.Kernel.FIELD_MULTIPLY);
         int[] g = ((Ed25519FieldElement)val).t;
         long x1;
         long x2;
@@ -495,6 +496,7 @@ public class Ed25519FieldElement extends FieldElement {
      * @return The (reasonably reduced) square of this field element.
      */
     public FieldElement square() {
+        if (KernelProfiler.ENABLED) KernelProfiler.count(KernelProfiler.Kernel.FIELD_SQUARE);
         int f0 = t[0];
         int f1 = t[1];
         int f2 = t[2];
@@ -651,6 +653,7 @@ public class Ed25519FieldElement extends FieldElement {
      * @return The (reasonably reduced) square of this field element times 2.
      */
     public FieldElement squareAndDouble() {
+        if (KernelProfiler.ENABLED) KernelProfiler.count(KernelProfiler.Kernel.FIELD_SQUARE);
         int f0 = t[0];
         int f1 = t[1];
         int f2 = t[2];
@@ -803,6 +806,9 @@ public class Ed25519FieldElement extends FieldElement {
      * @return The inverse of this field element.
      */
     public FieldElement invert() {
+        if (KernelProfiler.ENABLED) KernelProfiler.count(KernelProfiler.Kernel.FIELD_INVERT);
+        // Nest the squares and multiplications below under the inversion so that they aren't counted twice
+        String previousPhase = KernelProfiler.ENABLED ? KernelProfiler.enterPhase("field_invert") : null;
         FieldElement t0, t1, t2, t3;
 
         // 2 == 2 * 1
@@ -912,7 +918,9 @@ public class Ed25519FieldElement extends FieldElement {
         }
 
         // 2^255 - 21
-        return t1.multiply(t0);
+        FieldElement result = t1.multiply(t0);
+        if (KernelProfiler.ENABLED) KernelProfiler.exitPhase(previousPhase);
+        return result;
     }
 
     /**
@@ -924,6 +932,9 @@ public class Ed25519FieldElement extends FieldElement {
      * @return This field element to the power of $(2^{252} - 3)$.
      */
     public FieldElement pow22523() {
+        if (KernelProfiler.ENABLED) KernelProfiler.count(KernelProfiler.Kernel.FIELD_INVERT);
+        // Nest the squares and multiplications below under the inversion so that they aren't counted twice
+        String previousPhase = KernelProfiler.ENABLED ? KernelProfiler.enterPhase("field_invert") : null;
         FieldElement t0, t1, t2;
 
         // 2 == 2 * 1
@@ -1031,7 +1042,9 @@ public class Ed25519FieldElement extends FieldElement {
         t0 = t0.square();
 
         // 2^252 - 3
-        return multiply(t0);
+        FieldElement result = multiply(t0);
+        if (KernelProfiler.ENABLED) KernelProfiler.exitPhase(previousPhase);
+        return result;
     }
 
     /**
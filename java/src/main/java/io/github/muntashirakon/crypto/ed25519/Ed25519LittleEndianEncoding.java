@@ -6,6 +6,9 @@
 
 package io.github.muntashirakon.crypto.ed25519;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
 /**
  * Helper class for encoding/decoding from/to the 32 byte representation.
  * <p>
@@ -130,49 +133,15 @@ public class Ed25519LittleEndianEncoding {
         carry9 = h9 >> 25;               h9 -= carry9 << 25;
 
         // Step 2 (straight forward conversion):
+        // h0, ..., h9 are non-negative and have 26 and 25 bits alternately.
         byte[] s = new byte[32];
-        s[0] = (byte) h0;
-        s[1] = (byte) (h0 >> 8);
-        s[2] = (byte) (h0 >> 16);
-        s[3] = (byte) ((h0 >> 24) | (h1 << 2));
-        s[4] = (byte) (h1 >> 6);
-        s[5] = (byte) (h1 >> 14);
-        s[6] = (byte) ((h1 >> 22) | (h2 << 3));
-        s[7] = (byte) (h2 >> 5);
-        s[8] = (byte) (h2 >> 13);
-        s[9] = (byte) ((h2 >> 21) | (h3 << 5));
-        s[10] = (byte) (h3 >> 3);
-        s[11] = (byte) (h3 >> 11);
-        s[12] = (byte) ((h3 >> 19) | (h4 << 6));
-        s[13] = (byte) (h4 >> 2);
-        s[14] = (byte) (h4 >> 10);
-        s[15] = (byte) (h4 >> 18);
-        s[16] = (byte) h5;
-        s[17] = (byte) (h5 >> 8);
-        s[18] = (byte) (h5 >> 16);
-        s[19] = (byte) ((h5 >> 24) | (h6 << 1));
-        s[20] = (byte) (h6 >> 7);
-        s[21] = (byte) (h6 >> 15);
-        s[22] = (byte) ((h6 >> 23) | (h7 << 3));
-        s[23] = (byte) (h7 >> 5);
-        s[24] = (byte) (h7 >> 13);
-        s[25] = (byte) ((h7 >> 21) | (h8 << 4));
-        s[26] = (byte) (h8 >> 4);
-        s[27] = (byte) (h8 >> 12);
-        s[28] = (byte) ((h8 >> 20) | (h9 << 6));
-        s[29] = (byte) (h9 >> 2);
-        s[30] = (byte) (h9 >> 10);
-        s[31] = (byte) (h9 >> 18);
+        store_8(s, 0, (long) h0 | ((long) h1 << 26) | ((long) h2 << 51));
+        store_8(s, 8, ((long) h2 >> 13) | ((long) h3 << 13) | ((long) h4 << 38));
+        store_8(s, 16, (long) h5 | ((long) h6 << 25) | ((long) h7 << 51));
+        store_8(s, 24, ((long) h7 >> 13) | ((long) h8 << 12) | ((long) h9 << 38));
         return s;
     }
 
-    static int load_3(byte[] in, int offset) {
-        int result = in[offset++] & 0xff;
-        result |= (in[offset++] & 0xff) << 8;
-        result |= (in[offset] & 0xff) << 16;
-        return result;
-    }
-
     static long load_4(byte[] in, int offset) {
         int result = in[offset++] & 0xff;
         result |= (in[offset++] & 0xff) << 8;
@@ -181,6 +150,24 @@ public class Ed25519LittleEndianEncoding {
         return ((long)result) & 0xffffffffL;
     }
 
+    /**
+     * Loads 8 bytes in little-endian order. This is assembled from two {@link #load_4(byte[], int)} rather than read
+     * through a {@link ByteBuffer} view, since wrapping the array costs an allocation unless the VM can prove that the
+     * wrapper doesn't escape, which neither Java 8 nor ART guarantee.
+     */
+    static long load_8(byte[] in, int offset) {
+        return load_4(in, offset) | (load_4(in, offset + 4) << 32);
+    }
+
+    /**
+     * Stores 8 bytes in little-endian order.
+     */
+    static void store_8(byte[] out, int offset, long value) {
+        for (int i = 0; i < 8; ++i) {
+            out[offset + i] = (byte) (value >> (8 * i));
+        }
+    }
+
     /**
      * Decodes a given field element in its 10 byte $2^{25.5}$ representation.
      *
@@ -188,16 +175,58 @@ public class Ed25519LittleEndianEncoding {
      * @return The field element in its $2^{25.5}$ bit representation.
      */
     public FieldElement decode(byte[] in) {
-        long h0 = load_4(in, 0);
-        long h1 = load_3(in, 4) << 6;
-        long h2 = load_3(in, 7) << 5;
-        long h3 = load_3(in, 10) << 3;
-        long h4 = load_3(in, 13) << 2;
-        long h5 = load_4(in, 16);
-        long h6 = load_3(in, 20) << 7;
-        long h7 = load_3(in, 23) << 5;
-        long h8 = load_3(in, 26) << 4;
-        long h9 = (load_3(in, 29) & 0x7FFFFF) << 2;
+        return decode(in, 0);
+    }
+
+    private FieldElement decode(byte[] in, int off) {
+        return decode(load_8(in, off), load_8(in, off + 8), load_8(in, off + 16), load_8(in, off + 24));
+    }
+
+    /**
+     * Same as {@link #decode(byte[])}, but reads the 32 byte representation from a heap or direct buffer in place.
+     * Neither the position nor the byte order of the buffer is changed.
+     *
+     * @param in  The buffer.
+     * @param off Absolute offset of the 32 byte representation.
+     * @return The field element in its $2^{25.5}$ bit representation.
+     */
+    public FieldElement decode(ByteBuffer in, int off) {
+        if (off < 0 || off > in.limit() - 32) {
+            throw new IndexOutOfBoundsException();
+        }
+        if (in.hasArray()) {
+            return decode(in.array(), in.arrayOffset() + off);
+        }
+        // Swap the bytes instead of changing the order of a duplicate, which would allocate
+        long w0 = in.getLong(off);
+        long w1 = in.getLong(off + 8);
+        long w2 = in.getLong(off + 16);
+        long w3 = in.getLong(off + 24);
+        if (in.order() != ByteOrder.LITTLE_ENDIAN) {
+            w0 = Long.reverseBytes(w0);
+            w1 = Long.reverseBytes(w1);
+            w2 = Long.reverseBytes(w2);
+            w3 = Long.reverseBytes(w3);
+        }
+        return decode(w0, w1, w2, w3);
+    }
+
+    /**
+     * @param w0 Bytes 0 to 7 in little-endian order, and so on
+     */
+    private FieldElement decode(long w0, long w1, long w2, long w3) {
+        // Same limbs as loading 4, 3, 3, 3, 3, 4, 3, 3, 3 and 3 bytes from offsets 0, 4, 7, 10, 13, 16, 20, 23, 26
+        // and 29 respectively
+        long h0 = w0 & 0xFFFFFFFFL;
+        long h1 = ((w0 >>> 32) & 0xFFFFFF) << 6;
+        long h2 = (((w0 >>> 56) | (w1 << 8)) & 0xFFFFFF) << 5;
+        long h3 = ((w1 >>> 16) & 0xFFFFFF) << 3;
+        long h4 = ((w1 >>> 40) & 0xFFFFFF) << 2;
+        long h5 = w2 & 0xFFFFFFFFL;
+        long h6 = ((w2 >>> 32) & 0xFFFFFF) << 7;
+        long h7 = (((w2 >>> 56) | (w3 << 8)) & 0xFFFFFF) << 5;
+        long h8 = ((w3 >>> 16) & 0xFFFFFF) << 4;
+        long h9 = ((w3 >>> 40) & 0x7FFFFF) << 2;
         long carry0;
         long carry1;
         long carry2;
@@ -6,8 +6,8 @@
 
 package io.github.muntashirakon.crypto.ed25519;
 
-import static io.github.muntashirakon.crypto.ed25519.Ed25519LittleEndianEncoding.load_3;
-import static io.github.muntashirakon.crypto.ed25519.Ed25519LittleEndianEncoding.load_4;
+import static io.github.muntashirakon.crypto.ed25519.Ed25519LittleEndianEncoding.load_8;
+import static io.github.muntashirakon.crypto.ed25519.Ed25519LittleEndianEncoding.store_8;
 
 /**
  * Class for reducing a huge integer modulo the group order q and
@@ -30,31 +30,39 @@ public class Ed25519ScalarOps {
      *   where $q = 2^{252} + 27742317777372353535851937790883648493$.
      */
     public byte[] reduce(byte[] s) {
+        long w0 = load_8(s, 0);
+        long w1 = load_8(s, 8);
+        long w2 = load_8(s, 16);
+        long w3 = load_8(s, 24);
+        long w4 = load_8(s, 32);
+        long w5 = load_8(s, 40);
+        long w6 = load_8(s, 48);
+        long w7 = load_8(s, 56);
         // s0,..., s22 have 21 bits, s23 has 29 bits
-        long s0 = 0x1FFFFF & load_3(s, 0);
-        long s1 = 0x1FFFFF & (load_4(s, 2) >> 5);
-        long s2 = 0x1FFFFF & (load_3(s, 5) >> 2);
-        long s3 = 0x1FFFFF & (load_4(s, 7) >> 7);
-        long s4 = 0x1FFFFF & (load_4(s, 10) >> 4);
-        long s5 = 0x1FFFFF & (load_3(s, 13) >> 1);
-        long s6 = 0x1FFFFF & (load_4(s, 15) >> 6);
-        long s7 = 0x1FFFFF & (load_3(s, 18) >> 3);
-        long s8 = 0x1FFFFF & load_3(s, 21);
-        long s9 = 0x1FFFFF & (load_4(s, 23) >> 5);
-        long s10 = 0x1FFFFF & (load_3(s, 26) >> 2);
-        long s11 = 0x1FFFFF & (load_4(s, 28) >> 7);
-        long s12 = 0x1FFFFF & (load_4(s, 31) >> 4);
-        long s13 = 0x1FFFFF & (load_3(s, 34) >> 1);
-        long s14 = 0x1FFFFF & (load_4(s, 36) >> 6);
-        long s15 = 0x1FFFFF & (load_3(s, 39) >> 3);
-        long s16 = 0x1FFFFF & load_3(s, 42);
-        long s17 = 0x1FFFFF & (load_4(s, 44) >> 5);
-        long s18 = 0x1FFFFF & (load_3(s, 47) >> 2);
-        long s19 = 0x1FFFFF & (load_4(s, 49) >> 7);
-        long s20 = 0x1FFFFF & (load_4(s, 52) >> 4);
-        long s21 = 0x1FFFFF & (load_3(s, 55) >> 1);
-        long s22 = 0x1FFFFF & (load_4(s, 57) >> 6);
-        long s23 = (load_4(s, 60) >> 3);
+        long s0 = 0x1FFFFF & w0;
+        long s1 = 0x1FFFFF & (w0 >>> 21);
+        long s2 = 0x1FFFFF & (w0 >>> 42);
+        long s3 = 0x1FFFFF & ((w0 >>> 63) | (w1 << 1));
+        long s4 = 0x1FFFFF & (w1 >>> 20);
+        long s5 = 0x1FFFFF & (w1 >>> 41);
+        long s6 = 0x1FFFFF & ((w1 >>> 62) | (w2 << 2));
+        long s7 = 0x1FFFFF & (w2 >>> 19);
+        long s8 = 0x1FFFFF & (w2 >>> 40);
+        long s9 = 0x1FFFFF & ((w2 >>> 61) | (w3 << 3));
+        long s10 = 0x1FFFFF & (w3 >>> 18);
+        long s11 = 0x1FFFFF & (w3 >>> 39);
+        long s12 = 0x1FFFFF & ((w3 >>> 60) | (w4 << 4));
+        long s13 = 0x1FFFFF & (w4 >>> 17);
+        long s14 = 0x1FFFFF & (w4 >>> 38);
+        long s15 = 0x1FFFFF & ((w4 >>> 59) | (w5 << 5));
+        long s16 = 0x1FFFFF & (w5 >>> 16);
+        long s17 = 0x1FFFFF & (w5 >>> 37);
+        long s18 = 0x1FFFFF & ((w5 >>> 58) | (w6 << 6));
+        long s19 = 0x1FFFFF & (w6 >>> 15);
+        long s20 = 0x1FFFFF & (w6 >>> 36);
+        long s21 = 0x1FFFFF & ((w6 >>> 57) | (w7 << 7));
+        long s22 = 0x1FFFFF & (w7 >>> 14);
+        long s23 = (w7 >>> 35);
         long carry0;
         long carry1;
         long carry2;
@@ -281,38 +289,10 @@ public class Ed25519ScalarOps {
 
         // s0, ..., s11 got 21 bits each.
         byte[] result = new byte[32];
-        result[0] = (byte) s0;
-        result[1] = (byte) (s0 >> 8);
-        result[2] = (byte) ((s0 >> 16) | (s1 << 5));
-        result[3] = (byte) (s1 >> 3);
-        result[4] = (byte) (s1 >> 11);
-        result[5] = (byte) ((s1 >> 19) | (s2 << 2));
-        result[6] = (byte) (s2 >> 6);
-        result[7] = (byte) ((s2 >> 14) | (s3 << 7));
-        result[8] = (byte) (s3 >> 1);
-        result[9] = (byte) (s3 >> 9);
-        result[10] = (byte) ((s3 >> 17) | (s4 << 4));
-        result[11] = (byte) (s4 >> 4);
-        result[12] = (byte) (s4 >> 12);
-        result[13] = (byte) ((s4 >> 20) | (s5 << 1));
-        result[14] = (byte) (s5 >> 7);
-        result[15] = (byte) ((s5 >> 15) | (s6 << 6));
-        result[16] = (byte) (s6 >> 2);
-        result[17] = (byte) (s6 >> 10);
-        result[18] = (byte) ((s6 >> 18) | (s7 << 3));
-        result[19] = (byte) (s7 >> 5);
-        result[20] = (byte) (s7 >> 13);
-        result[21] = (byte) s8;
-        result[22] = (byte) (s8 >> 8);
-        result[23] = (byte) ((s8 >> 16) | (s9 << 5));
-        result[24] = (byte) (s9 >> 3);
-        result[25] = (byte) (s9 >> 11);
-        result[26] = (byte) ((s9 >> 19) | (s10 << 2));
-        result[27] = (byte) (s10 >> 6);
-        result[28] = (byte) ((s10 >> 14) | (s11 << 7));
-        result[29] = (byte) (s11 >> 1);
-        result[30] = (byte) (s11 >> 9);
-        result[31] = (byte) (s11 >> 17);
+        store_8(result, 0, s0 | (s1 << 21) | (s2 << 42) | (s3 << 63));
+        store_8(result, 8, (s3 >> 1) | (s4 << 20) | (s5 << 41) | (s6 << 62));
+        store_8(result, 16, (s6 >> 2) | (s7 << 19) | (s8 << 40) | (s9 << 61));
+        store_8(result, 24, (s9 >> 3) | (s10 << 18) | (s11 << 39));
         return result;
     }
 
@@ -333,42 +313,54 @@ public class Ed25519ScalarOps {
      * See the comments in {@link #reduce(byte[])} for an explanation of the algorithm.
      */
     public byte[] multiplyAndAdd(byte[] a, byte[] b, byte[] c) {
-        long a0 = 0x1FFFFF & load_3(a, 0);
-        long a1 = 0x1FFFFF & (load_4(a, 2) >> 5);
-        long a2 = 0x1FFFFF & (load_3(a, 5) >> 2);
-        long a3 = 0x1FFFFF & (load_4(a, 7) >> 7);
-        long a4 = 0x1FFFFF & (load_4(a, 10) >> 4);
-        long a5 = 0x1FFFFF & (load_3(a, 13) >> 1);
-        long a6 = 0x1FFFFF & (load_4(a, 15) >> 6);
-        long a7 = 0x1FFFFF & (load_3(a, 18) >> 3);
-        long a8 = 0x1FFFFF & load_3(a, 21);
-        long a9 = 0x1FFFFF & (load_4(a, 23) >> 5);
-        long a10 = 0x1FFFFF & (load_3(a, 26) >> 2);
-        long a11 = (load_4(a, 28) >> 7);
-        long b0 = 0x1FFFFF & load_3(b, 0);
-        long b1 = 0x1FFFFF & (load_4(b, 2) >> 5);
-        long b2 = 0x1FFFFF & (load_3(b, 5) >> 2);
-        long b3 = 0x1FFFFF & (load_4(b, 7) >> 7);
-        long b4 = 0x1FFFFF & (load_4(b, 10) >> 4);
-        long b5 = 0x1FFFFF & (load_3(b, 13) >> 1);
-        long b6 = 0x1FFFFF & (load_4(b, 15) >> 6);
-        long b7 = 0x1FFFFF & (load_3(b, 18) >> 3);
-        long b8 = 0x1FFFFF & load_3(b, 21);
-        long b9 = 0x1FFFFF & (load_4(b, 23) >> 5);
-        long b10 = 0x1FFFFF & (load_3(b, 26) >> 2);
-        long b11 = (load_4(b, 28) >> 7);
-        long c0 = 0x1FFFFF & load_3(c, 0);
-        long c1 = 0x1FFFFF & (load_4(c, 2) >> 5);
-        long c2 = 0x1FFFFF & (load_3(c, 5) >> 2);
-        long c3 = 0x1FFFFF & (load_4(c, 7) >> 7);
-        long c4 = 0x1FFFFF & (load_4(c, 10) >> 4);
-        long c5 = 0x1FFFFF & (load_3(c, 13) >> 1);
-        long c6 = 0x1FFFFF & (load_4(c, 15) >> 6);
-        long c7 = 0x1FFFFF & (load_3(c, 18) >> 3);
-        long c8 = 0x1FFFFF & load_3(c, 21);
-        long c9 = 0x1FFFFF & (load_4(c, 23) >> 5);
-        long c10 = 0x1FFFFF & (load_3(c, 26) >> 2);
-        long c11 = (load_4(c, 28) >> 7);
+        long aw0 = load_8(a, 0);
+        long aw1 = load_8(a, 8);
+        long aw2 = load_8(a, 16);
+        long aw3 = load_8(a, 24);
+        long bw0 = load_8(b, 0);
+        long bw1 = load_8(b, 8);
+        long bw2 = load_8(b, 16);
+        long bw3 = load_8(b, 24);
+        long cw0 = load_8(c, 0);
+        long cw1 = load_8(c, 8);
+        long cw2 = load_8(c, 16);
+        long cw3 = load_8(c, 24);
+        long a0 = 0x1FFFFF & aw0;
+        long a1 = 0x1FFFFF & (aw0 >>> 21);
+        long a2 = 0x1FFFFF & (aw0 >>> 42);
+        long a3 = 0x1FFFFF & ((aw0 >>> 63) | (aw1 << 1));
+        long a4 = 0x1FFFFF & (aw1 >>> 20);
+        long a5 = 0x1FFFFF & (aw1 >>> 41);
+        long a6 = 0x1FFFFF & ((aw1 >>> 62) | (aw2 << 2));
+        long a7 = 0x1FFFFF & (aw2 >>> 19);
+        long a8 = 0x1FFFFF & (aw2 >>> 40);
+        long a9 = 0x1FFFFF & ((aw2 >>> 61) | (aw3 << 3));
+        long a10 = 0x1FFFFF & (aw3 >>> 18);
+        long a11 = (aw3 >>> 39);
+        long b0 = 0x1FFFFF & bw0;
+        long b1 = 0x1FFFFF & (bw0 >>> 21);
+        long b2 = 0x1FFFFF & (bw0 >>> 42);
+        long b3 = 0x1FFFFF & ((bw0 >>> 63) | (bw1 << 1));
+        long b4 = 0x1FFFFF & (bw1 >>> 20);
+        long b5 = 0x1FFFFF & (bw1 >>> 41);
+        long b6 = 0x1FFFFF & ((bw1 >>> 62) | (bw2 << 2));
+        long b7 = 0x1FFFFF & (bw2 >>> 19);
+        long b8 = 0x1FFFFF & (bw2 >>> 40);
+        long b9 = 0x1FFFFF & ((bw2 >>> 61) | (bw3 << 3));
+        long b10 = 0x1FFFFF & (bw3 >>> 18);
+        long b11 = (bw3 >>> 39);
+        long c0 = 0x1FFFFF & cw0;
+        long c1 = 0x1FFFFF & (cw0 >>> 21);
+        long c2 = 0x1FFFFF & (cw0 >>> 42);
+        long c3 = 0x1FFFFF & ((cw0 >>> 63) | (cw1 << 1));
+        long c4 = 0x1FFFFF & (cw1 >>> 20);
+        long c5 = 0x1FFFFF & (cw1 >>> 41);
+        long c6 = 0x1FFFFF & ((cw1 >>> 62) | (cw2 << 2));
+        long c7 = 0x1FFFFF & (cw2 >>> 19);
+        long c8 = 0x1FFFFF & (cw2 >>> 40);
+        long c9 = 0x1FFFFF & ((cw2 >>> 61) | (cw3 << 3));
+        long c10 = 0x1FFFFF & (cw3 >>> 18);
+        long c11 = (cw3 >>> 39);
         long s0;
         long s1;
         long s2;
@@ -649,39 +641,12 @@ public class Ed25519ScalarOps {
         carry9 = s9 >> 21; s10 += carry9; s9 -= carry9 << 21;
         carry10 = s10 >> 21; s11 += carry10; s10 -= carry10 << 21;
 
+        // s0, ..., s11 got 21 bits each.
         byte[] result = new byte[32];
-        result[0] = (byte) s0;
-        result[1] = (byte) (s0 >> 8);
-        result[2] = (byte) ((s0 >> 16) | (s1 << 5));
-        result[3] = (byte) (s1 >> 3);
-        result[4] = (byte) (s1 >> 11);
-        result[5] = (byte) ((s1 >> 19) | (s2 << 2));
-        result[6] = (byte) (s2 >> 6);
-        result[7] = (byte) ((s2 >> 14) | (s3 << 7));
-        result[8] = (byte) (s3 >> 1);
-        result[9] = (byte) (s3 >> 9);
-        result[10] = (byte) ((s3 >> 17) | (s4 << 4));
-        result[11] = (byte) (s4 >> 4);
-        result[12] = (byte) (s4 >> 12);
-        result[13] = (byte) ((s4 >> 20) | (s5 << 1));
-        result[14] = (byte) (s5 >> 7);
-        result[15] = (byte) ((s5 >> 15) | (s6 << 6));
-        result[16] = (byte) (s6 >> 2);
-        result[17] = (byte) (s6 >> 10);
-        result[18] = (byte) ((s6 >> 18) | (s7 << 3));
-        result[19] = (byte) (s7 >> 5);
-        result[20] = (byte) (s7 >> 13);
-        result[21] = (byte) s8;
-        result[22] = (byte) (s8 >> 8);
-        result[23] = (byte) ((s8 >> 16) | (s9 << 5));
-        result[24] = (byte) (s9 >> 3);
-        result[25] = (byte) (s9 >> 11);
-        result[26] = (byte) ((s9 >> 19) | (s10 << 2));
-        result[27] = (byte) (s10 >> 6);
-        result[28] = (byte) ((s10 >> 14) | (s11 << 7));
-        result[29] = (byte) (s11 >> 1);
-        result[30] = (byte) (s11 >> 9);
-        result[31] = (byte) (s11 >> 17);
+        store_8(result, 0, s0 | (s1 << 21) | (s2 << 42) | (s3 << 63));
+        store_8(result, 8, (s3 >> 1) | (s4 << 20) | (s5 << 41) | (s6 << 62));
+        store_8(result, 16, (s6 >> 2) | (s7 << 19) | (s8 << 40) | (s9 << 61));
+        store_8(result, 24, (s9 >> 3) | (s10 << 18) | (s11 << 39));
         return result;
     }
 }
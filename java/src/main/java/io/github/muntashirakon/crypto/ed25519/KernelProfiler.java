@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+package io.github.muntashirakon.crypto.ed25519;
+
+import java.util.LinkedHashMap;
+import java.util.Locale;
+import java.util.Map;
+
+/**
+ * Counts the calls to each class of kernels, grouped by the phase of the protocol they are made from, on the current
+ * thread. Only the number of calls is recorded, not the time spent in them. Only the Java implementation is covered,
+ * i.e. neither the JNI marshalling nor the native code of the Android library is counted.
+ * <p>
+ * The counters are compiled in only when the library is built with the Gradle property {@code spake2.profile} set to
+ * {@code true}, e.g. {@code ./gradlew :java:profileTest -Pspake2.profile=true}. The build generates {@link #ENABLED}
+ * as a compile-time constant and every counter is guarded by it, so javac leaves the counters out of the regular
+ * build and neither the JIT nor ART ever see them.
+ * <p>
+ * Usage:
+ * <pre>
+ * KernelProfiler profiler = KernelProfiler.start();
+ * // generate and process the messages
+ * profiler.stop();
+ * System.out.print(profiler.toFoldedStacks());
+ * </pre>
+ */
+public final class KernelProfiler {
+    public static final boolean ENABLED = ProfilerFlag.ENABLED;
+
+    public enum Kernel {
+        /**
+         * {@link FieldElement#multiply(FieldElement)}
+         */
+        FIELD_MULTIPLY,
+        /**
+         * {@link FieldElement#square()} and {@link FieldElement#squareAndDouble()}
+         */
+        FIELD_SQUARE,
+        /**
+         * {@link FieldElement#invert()} and {@link FieldElement#pow22523()}. Their squares and multiplications are
+         * counted in the nested phase {@code field_invert}, e.g. {@code processMessage;field_invert}.
+         */
+        FIELD_INVERT,
+        /**
+         * Constant-time lookups in precomputed tables
+         */
+        TABLE_SELECT,
+        /**
+         * SHA-512 instances obtained for the protocol hashes
+         */
+        SHA512,
+    }
+
+    private static final String NO_PHASE = "other";
+    private static final ThreadLocal<KernelProfiler> CURRENT = new ThreadLocal<>();
+
+    private final Map<String, long[]> counts = new LinkedHashMap<>();
+    private String phase;
+    private long[] phaseCounts;
+
+    private KernelProfiler() {
+        setPhase(NO_PHASE);
+    }
+
+    /**
+     * Starts counting the kernels called on the current thread, discarding the profiler that was running there, if any.
+     *
+     * @throws IllegalStateException If profiling is disabled.
+     */
+    public static KernelProfiler start() throws IllegalStateException {
+        if (!ENABLED) {
+            throw new IllegalStateException("Profiling is disabled, build with -Pspake2.profile=true.");
+        }
+        KernelProfiler profiler = new KernelProfiler();
+        CURRENT.set(profiler);
+        return profiler;
+    }
+
+    /**
+     * Stops counting if this is the profiler of the current thread.
+     */
+    public void stop() {
+        if (CURRENT.get() == this) {
+            CURRENT.remove();
+        }
+    }
+
+    public static void count(Kernel kernel) {
+        KernelProfiler profiler = CURRENT.get();
+        if (profiler != null) {
+            ++profiler.phaseCounts[kernel.ordinal()];
+        }
+    }
+
+    /**
+     * Attributes the kernels called from now on to the given phase.
+     *
+     * @return The current phase which must be given to {@link #exitPhase(String)}.
+     */
+    public static String enterPhase(String phase) {
+        KernelProfiler profiler = CURRENT.get();
+        if (profiler == null) {
+            return null;
+        }
+        String previous = profiler.phase;
+        profiler.setPhase(previous.equals(NO_PHASE) ? phase : previous + ';' + phase);
+        return previous;
+    }
+
+    public static void exitPhase(String previous) {
+        KernelProfiler profiler = CURRENT.get();
+        if (profiler != null && previous != null) {
+            profiler.setPhase(previous);
+        }
+    }
+
+    /**
+     * @param phase Phases separated by semicolons, e.g. {@code "generateMessage"}.
+     */
+    public long getCount(String phase, Kernel kernel) {
+        long[] phaseCounts = counts.get(phase);
+        return phaseCounts == null ? 0 : phaseCounts[kernel.ordinal()];
+    }
+
+    /**
+     * @return The count of every kernel of every phase.
+     */
+    public Map<Kernel, Long> getTotals() {
+        Map<Kernel, Long> totals = new LinkedHashMap<>();
+        for (Kernel kernel : Kernel.values()) {
+            long total = 0;
+            for (long[] phaseCounts : counts.values()) {
+                total += phaseCounts[kernel.ordinal()];
+            }
+            totals.put(kernel, total);
+        }
+        return totals;
+    }
+
+    /**
+     * @return One {@code phase;kernel count} line per kernel called in each phase, which can be fed to flamegraph.pl.
+     */
+    public String toFoldedStacks() {
+        StringBuilder sb = new StringBuilder();
+        for (Map.Entry<String, long[]> entry : counts.entrySet()) {
+            for (Kernel kernel : Kernel.values()) {
+                long count = entry.getValue()[kernel.ordinal()];
+                if (count != 0) {
+                    sb.append(entry.getKey()).append(';').append(kernel.name().toLowerCase(Locale.ROOT))
+                            .append(' ').append(count).append('\n');
+                }
+            }
+        }
+        return sb.toString();
+    }
+
+    private void setPhase(String phase) {
+        this.phase = phase;
+        long[] phaseCounts = counts.get(phase);
+        if (phaseCounts == null) {
+            phaseCounts = new long[Kernel.values().length];
+            counts.put(phase, phaseCounts);
+        }
+        this.phaseCounts = phaseCounts;
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+package io.github.muntashirakon.crypto.ed25519;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Variable-base scalar multiplication using the x-only Montgomery ladder on the birationally equivalent curve
+ * $v^2 = u^3 + A u^2 + u$ with $A = 486662$.
+ * <p>
+ * The maps between the two models are (see RFC 7748, section 4.1):
+ * </p><ul>
+ * <li>$(u, v) = ((1 + y) / (1 - y), \sqrt{-486664} u / x)$
+ * <li>$(x, y) = (\sqrt{-486664} u / v, (u - 1) / (u + 1))$
+ * </ul><p>
+ * Since the ladder only keeps track of $u$, the $v$ coordinate of the result is recovered at the end using the
+ * Okeya–Sakurai formula, which is all that is needed to compute the Edwards encoding of the result.
+ * <p>
+ * Literature:<br>
+ * [1] Craig Costello, Benjamin Smith: Montgomery curves and their arithmetic (Algorithm 5)<br>
+ */
+public class MontgomeryLadder {
+    /**
+     * $\sqrt{-486664}$
+     */
+    private static final byte[] B_SQRT_M486664 = Utils.hexToBytes("067e45ffaa046ecc821a7d4bd1d3a1c57e4ffc03dc087bd2bb06a060f4ed260f");
+    /**
+     * $(A - 2) / 4 = 121665$
+     */
+    private static final byte[] B_A24 = Utils.hexToBytes("41db010000000000000000000000000000000000000000000000000000000000");
+    /**
+     * $2A = 973324$
+     */
+    private static final byte[] B_2A = Utils.hexToBytes("0cda0e0000000000000000000000000000000000000000000000000000000000");
+
+    private final Ed25519Field f;
+    private final FieldElement sqrtM486664;
+    private final FieldElement a24;
+    private final FieldElement a2;
+
+    public MontgomeryLadder(Curve curve) {
+        this.f = curve.getField();
+        this.sqrtM486664 = f.fromByteArray(B_SQRT_M486664);
+        this.a24 = f.fromByteArray(B_A24);
+        this.a2 = f.fromByteArray(B_2A);
+    }
+
+    /**
+     * $h = a * P$ where $a = a[0]+256*a[1]+\dots+256^{31} a[31]$.
+     * <p>
+     * All 256 bits of $a$ are processed, no clamping is done. The ladder itself is constant time. The only branches
+     * are for the exceptional points, namely if $P$ has order at most two or if the result is the neutral element.
+     * Since $a$ is expected to be a multiple of the cofactor, these only depend on the (public) point $P$.
+     *
+     * @param P The point in P2 or P3 representation.
+     * @param a $= a[0]+256*a[1]+\dots+256^{31} a[31]$
+     * @return The encoded point $a * P$, same as {@code P.scalarMultiply(a).toByteArray()} for a precomputed $P$.
+     */
+    public byte[] scalarMultiply(final GroupElement P, final byte[] a) {
+        return scalarMultiply(P, ByteBuffer.wrap(a), 0);
+    }
+
+    /**
+     * Same as {@link #scalarMultiply(GroupElement, byte[])}, but reads $a$ in place from a heap or direct buffer.
+     *
+     * @param off Absolute offset of $a$.
+     */
+    public byte[] scalarMultiply(final GroupElement P, final ByteBuffer a, int off) {
+        final FieldElement X = P.getX();
+        final FieldElement Y = P.getY();
+        final FieldElement Z = P.getZ();
+
+        if (!X.isNonZero()) {
+            // P is either the neutral element or (0, -1). In both cases, a multiple of eight yields the neutral element.
+            return f.ONE.toByteArray();
+        }
+
+        // Affine (u, v) using a single inversion
+        final FieldElement zpy = Z.add(Y);
+        final FieldElement inv = Z.subtract(Y).multiply(X).invert();
+        final FieldElement u = zpy.multiply(X).multiply(inv);
+        final FieldElement v = sqrtM486664.multiply(zpy).multiply(Z).multiply(inv);
+
+        FieldElement x2 = f.ONE;
+        FieldElement z2 = f.ZERO;
+        FieldElement x3 = u;
+        FieldElement z3 = f.ONE;
+        FieldElement tmp;
+        int swap = 0;
+
+        for (int pos = 255; pos >= 0; --pos) {
+            final int bit = Utils.bit(a, off, pos);
+            swap ^= bit;
+            tmp = x2.cmov(x3, swap);
+            x3 = x3.cmov(x2, swap);
+            x2 = tmp;
+            tmp = z2.cmov(z3, swap);
+            z3 = z3.cmov(z2, swap);
+            z2 = tmp;
+            swap = bit;
+
+            final FieldElement A = x2.add(z2);
+            final FieldElement AA = A.square();
+            final FieldElement B = x2.subtract(z2);
+            final FieldElement BB = B.square();
+            final FieldElement E = AA.subtract(BB);
+            final FieldElement C = x3.add(z3);
+            final FieldElement D = x3.subtract(z3);
+            final FieldElement DA = D.multiply(A);
+            final FieldElement CB = C.multiply(B);
+            x3 = DA.add(CB).square();
+            z3 = u.multiply(DA.subtract(CB).square());
+            x2 = AA.multiply(BB);
+            z2 = E.multiply(AA.add(a24.multiply(E)));
+        }
+        tmp = x2.cmov(x3, swap);
+        x3 = x3.cmov(x2, swap);
+        x2 = tmp;
+        tmp = z2.cmov(z3, swap);
+        z3 = z3.cmov(z2, swap);
+        z2 = tmp;
+
+        if (!z2.isNonZero()) {
+            // a * P is the neutral element
+            return f.ONE.toByteArray();
+        }
+        if (!z3.isNonZero()) {
+            // (a + 1) * P is the neutral element, thus a * P = -P
+            byte[] s = P.toByteArray();
+            s[s.length - 1] ^= (byte) 0x80;
+            return s;
+        }
+
+        // Recover v of (x2 : z2) given (u, v) and (x3 : z3), see [1]
+        FieldElement v1 = u.multiply(z2);
+        FieldElement v2 = x2.add(v1);
+        FieldElement v3 = x2.subtract(v1).square().multiply(x3);
+        v1 = a2.multiply(z2);
+        v2 = v2.add(v1);
+        FieldElement v4 = u.multiply(x2).add(z2);
+        v2 = v2.multiply(v4).subtract(v1.multiply(z2)).multiply(z3);
+        final FieldElement MY = v2.subtract(v3);
+        v1 = v.add(v).multiply(z2).multiply(z3);
+        final FieldElement MX = v1.multiply(x2);
+        final FieldElement MZ = v1.multiply(z2);
+
+        // Back to Edwards using a single inversion
+        final FieldElement mxpmz = MX.add(MZ);
+        final FieldElement recip = MY.multiply(mxpmz).invert();
+        final FieldElement x = sqrtM486664.multiply(MX).multiply(mxpmz).multiply(recip);
+        final FieldElement y = MX.subtract(MZ).multiply(MY).multiply(recip);
+        byte[] s = y.toByteArray();
+        s[s.length - 1] |= (x.isNegative() ? (byte) 0x80 : 0);
+        return s;
+    }
+}
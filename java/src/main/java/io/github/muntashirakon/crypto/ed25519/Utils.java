@@ -6,6 +6,8 @@
 
 package io.github.muntashirakon.crypto.ed25519;
 
+import java.nio.ByteBuffer;
+
 /**
  * Basic utilities for Ed25519.
  * Not for external use, not maintained as a public API.
@@ -60,6 +62,13 @@ public class Utils {
         return (h[i >> 3] >> (i & 7)) & 1;
     }
 
+    /**
+     * Same as {@link #bit(byte[], int)} for the bytes of a buffer starting at the absolute offset {@code off}.
+     */
+    public static int bit(ByteBuffer h, int off, int i) {
+        return (h.get(off + (i >> 3)) >> (i & 7)) & 1;
+    }
+
     /**
      * Converts a hex string to bytes.
      * @param s the hex string to be converted.
@@ -6,6 +6,12 @@
 
 package io.github.muntashirakon.crypto.spake2;
 
+import java.nio.Buffer;
+import java.nio.BufferOverflowException;
+import java.nio.BufferUnderflowException;
+import java.nio.ByteBuffer;
+import java.nio.ReadOnlyBufferException;
+import java.security.DigestException;
 import java.security.MessageDigest;
 import java.security.NoSuchAlgorithmException;
 import java.security.SecureRandom;
@@ -20,6 +26,8 @@ import io.github.muntashirakon.crypto.ed25519.Ed25519Field;
 import io.github.muntashirakon.crypto.ed25519.Ed25519ScalarOps;
 import io.github.muntashirakon.crypto.ed25519.FieldElement;
 import io.github.muntashirakon.crypto.ed25519.GroupElement;
+import io.github.muntashirakon.crypto.ed25519.KernelProfiler;
+import io.github.muntashirakon.crypto.ed25519.MontgomeryLadder;
 import io.github.muntashirakon.crypto.ed25519.Utils;
 
 @SuppressWarnings("unused")
@@ -263,21 +271,29 @@ public class Spake2Context implements Destroyable {
 
     static final GroupElement[] SPAKE_N_SMALL_PRECOMP;
     static final GroupElement[] SPAKE_M_SMALL_PRECOMP;
+    static final MontgomeryLadder MONTGOMERY_LADDER;
 
     static {
         Ed25519CurveParameterSpec spec = Ed25519.getSpec();
         SPAKE_N_SMALL_PRECOMP = getGEFromTable(spec.getCurve(), PRECOMP_TABLE_N);
         SPAKE_M_SMALL_PRECOMP = getGEFromTable(spec.getCurve(), PRECOMP_TABLE_M);
+        MONTGOMERY_LADDER = new MontgomeryLadder(spec.getCurve());
     }
 
-    private final byte[] myName;
-    private final byte[] theirName;
+    // Layout of the secret state, followed by the names in Spake2Context
+    static final int OFFSET_PRIVATE_KEY = 0;
+    static final int OFFSET_MY_MSG = OFFSET_PRIVATE_KEY + 32;
+    static final int OFFSET_PASSWORD_SCALAR = OFFSET_MY_MSG + MAX_MSG_SIZE;
+    static final int OFFSET_PASSWORD_HASH = OFFSET_PASSWORD_SCALAR + 32;
+    static final int SECRETS_SIZE = OFFSET_PASSWORD_HASH + 64;
+
     private final Spake2Role myRole;
-    private final byte[] privateKey = new byte[32];
-    private final byte[] myMsg = new byte[32];
-    private final byte[] passwordScalar = new byte[32];
-    private final byte[] passwordHash = new byte[64];
-    private final Ed25519CurveParameterSpec curveSpec;
+    /**
+     * Private key, message, password scalar and password hash at the offsets above, followed by both the names.
+     */
+    private final byte[] data;
+    private final int myNameLen;
+    private final int theirNameLen;
 
     private State state;
     private boolean disablePasswordScalarHack;
@@ -287,14 +303,13 @@ public class Spake2Context implements Destroyable {
                          final byte[] myName,
                          final byte[] theirName) {
         this.myRole = myRole;
-        this.myName = new byte[myName.length];
-        this.theirName = new byte[theirName.length];
+        this.myNameLen = myName.length;
+        this.theirNameLen = theirName.length;
+        this.data = new byte[SECRETS_SIZE + myNameLen + theirNameLen];
         this.state = State.Init;
 
-        System.arraycopy(myName, 0, this.myName, 0, myName.length);
-        System.arraycopy(theirName, 0, this.theirName, 0, theirName.length);
-
-        curveSpec = Ed25519.getSpec();
+        System.arraycopy(myName, 0, this.data, SECRETS_SIZE, myNameLen);
+        System.arraycopy(theirName, 0, this.data, SECRETS_SIZE + myNameLen, theirNameLen);
     }
 
     public void setDisablePasswordScalarHack(boolean disablePasswordScalarHack) {
@@ -310,15 +325,20 @@ public class Spake2Context implements Destroyable {
     }
 
     public byte[] getMyMsg() {
-        return myMsg;
+        return Arrays.copyOfRange(data, OFFSET_MY_MSG, OFFSET_MY_MSG + MAX_MSG_SIZE);
     }
 
     public byte[] getMyName() {
-        return myName;
+        return Arrays.copyOfRange(data, SECRETS_SIZE, SECRETS_SIZE + myNameLen);
     }
 
     public byte[] getTheirName() {
-        return theirName;
+        return Arrays.copyOfRange(data, SECRETS_SIZE + myNameLen, SECRETS_SIZE + myNameLen + theirNameLen);
+    }
+
+    // Package private for testing
+    int getStateSize() {
+        return data.length;
     }
 
     @Override
@@ -329,10 +349,7 @@ public class Spake2Context implements Destroyable {
     @Override
     public void destroy() {
         isDestroyed = true;
-        Arrays.fill(privateKey, (byte) 0);
-        Arrays.fill(myMsg, (byte) 0);
-        Arrays.fill(passwordScalar, (byte) 0);
-        Arrays.fill(passwordHash, (byte) 0);
+        Arrays.fill(data, 0, SECRETS_SIZE, (byte) 0);
     }
 
     /**
@@ -344,148 +361,245 @@ public class Spake2Context implements Destroyable {
     public byte[] generateMessage(final byte[] password) throws IllegalArgumentException, IllegalStateException {
         byte[] privateKey = new byte[64];
         new SecureRandom().nextBytes(privateKey);
-        System.out.printf("PVKEY(%s): %s%n", myRole, Utils.bytesToHex(privateKey));
         return generateMessage(password, privateKey);
     }
 
     // Package private method for testing purposes
     byte[] generateMessage(final byte[] password, byte[] privateKey) throws IllegalArgumentException, IllegalStateException {
+        generateMessage(ByteBuffer.wrap(password), privateKey);
+        return getMyMsg();
+    }
+
+    /**
+     * Same as {@link #generateMessage(byte[])}, but works on heap or direct buffers in place. The password is read
+     * from the position to the limit of {@code password}. The message is written at the position of {@code out}.
+     * The positions of both buffers are advanced.
+     *
+     * @param password Shared password.
+     * @param out      Buffer with at least {@link #MAX_MSG_SIZE} bytes remaining.
+     * @throws IllegalArgumentException If SHA-512 is unavailable for some reason.
+     * @throws IllegalStateException    If the message has already been generated.
+     * @throws BufferOverflowException  If {@code out} has less than {@link #MAX_MSG_SIZE} bytes remaining.
+     * @throws ReadOnlyBufferException  If {@code out} is read-only.
+     */
+    public void generateMessage(ByteBuffer password, ByteBuffer out) throws IllegalArgumentException,
+            IllegalStateException, BufferOverflowException, ReadOnlyBufferException {
+        checkState(State.Init);
+        if (out.isReadOnly()) {
+            throw new ReadOnlyBufferException();
+        }
+        if (out.remaining() < MAX_MSG_SIZE) {
+            throw new BufferOverflowException();
+        }
+        byte[] privateKey = new byte[64];
+        new SecureRandom().nextBytes(privateKey);
+        generateMessage(password, privateKey);
+        out.put(data, OFFSET_MY_MSG, MAX_MSG_SIZE);
+    }
+
+    private void generateMessage(ByteBuffer password, byte[] privateKey) throws IllegalArgumentException,
+            IllegalStateException {
+        String previousPhase = null;
+        try {
+            checkState(State.Init);
+            previousPhase = KernelProfiler.ENABLED ? KernelProfiler.enterPhase("generateMessage") : null;
+            computeMessage(this.myRole, this.disablePasswordScalarHack, password, privateKey,
+                    ByteBuffer.wrap(this.data));
+        } finally {
+            Arrays.fill(privateKey, (byte) 0);
+            if (KernelProfiler.ENABLED) KernelProfiler.exitPhase(previousPhase);
+        }
+        this.state = State.MsgGenerated;
+    }
+
+    /**
+     * @param theirMsg Message generated/received from the other end.
+     * @return Key of size {@link #MAX_KEY_SIZE}.
+     * @throws IllegalArgumentException If the message is invalid or SHA-512 is unavailable for some reason.
+     * @throws IllegalStateException    If the key has already been generated.
+     */
+    public byte[] processMessage(final byte[] theirMsg) throws IllegalArgumentException, IllegalStateException {
+        checkState(State.MsgGenerated);
+        byte[] key = new byte[MAX_KEY_SIZE];
+        processMessage(wrapMessage(theirMsg), ByteBuffer.wrap(key));
+        return key;
+    }
+
+    /**
+     * Same as {@link #processMessage(byte[])}, but works on heap or direct buffers in place. The message is read at
+     * the position of {@code theirMsg} and the key is written at the position of {@code keyOut}. The positions of
+     * both buffers are advanced.
+     *
+     * @param theirMsg Buffer with the message generated/received from the other end, i.e. {@link #MAX_MSG_SIZE} bytes.
+     * @param keyOut   Buffer with at least {@link #MAX_KEY_SIZE} bytes remaining.
+     * @throws IllegalArgumentException If the message is invalid or SHA-512 is unavailable for some reason.
+     * @throws IllegalStateException    If the key has already been generated.
+     * @throws BufferUnderflowException If {@code theirMsg} has less than {@link #MAX_MSG_SIZE} bytes remaining.
+     * @throws BufferOverflowException  If {@code keyOut} has less than {@link #MAX_KEY_SIZE} bytes remaining.
+     * @throws ReadOnlyBufferException  If {@code keyOut} is read-only.
+     */
+    public void processMessage(ByteBuffer theirMsg, ByteBuffer keyOut) throws IllegalArgumentException,
+            IllegalStateException, BufferUnderflowException, BufferOverflowException, ReadOnlyBufferException {
+        checkState(State.MsgGenerated);
+
+        if (theirMsg.remaining() < MAX_MSG_SIZE) {
+            throw new BufferUnderflowException();
+        }
+        if (keyOut.isReadOnly()) {
+            throw new ReadOnlyBufferException();
+        }
+        if (keyOut.remaining() < MAX_KEY_SIZE) {
+            throw new BufferOverflowException();
+        }
+
+        String previousPhase = KernelProfiler.ENABLED ? KernelProfiler.enterPhase("processMessage") : null;
+        try {
+            ByteBuffer data = ByteBuffer.wrap(this.data);
+            computeKey(this.myRole, data, SECRETS_SIZE, this.myNameLen, SECRETS_SIZE + this.myNameLen,
+                    this.theirNameLen, data, theirMsg, keyOut);
+        } finally {
+            if (KernelProfiler.ENABLED) KernelProfiler.exitPhase(previousPhase);
+        }
+        this.state = State.KeyGenerated;
+    }
+
+    private void checkState(State state) throws IllegalStateException {
         if (isDestroyed) {
             throw new IllegalStateException("The context was destroyed.");
         }
-        if (this.state != State.Init) {
+        if (this.state != state) {
             throw new IllegalStateException("Invalid state: " + this.state);
         }
+    }
 
+    /**
+     * Generates the message to be sent to the peer. This holds no state of its own so that it can be shared between
+     * {@link Spake2Context} and {@link Spake2ContextStore}.
+     *
+     * @param password   Read from the position to the limit, the position is advanced to the limit
+     * @param privateKey 64 random bytes, overwritten during the process
+     * @param secrets    At least {@link #SECRETS_SIZE} bytes where the private key (the ephemeral scalar multiplied by
+     *                   the cofactor), the message, the password scalar and the password hash are stored at their
+     *                   respective offsets, written in place
+     */
+    static void computeMessage(Spake2Role myRole, boolean disablePasswordScalarHack, ByteBuffer password,
+                               byte[] privateKey, ByteBuffer secrets) throws IllegalArgumentException {
+        Ed25519CurveParameterSpec curveSpec = Ed25519.getSpec();
         Ed25519ScalarOps scalarOps = curveSpec.getScalarOps();
 
         System.arraycopy(scalarOps.reduce(privateKey), 0, privateKey, 0, 32);
         // Multiply by the cofactor (eight) so that we'll clear it when operating on
         // the peer's point later in the protocol.
         leftShift3(privateKey);
-        System.arraycopy(privateKey, 0, this.privateKey, 0, this.privateKey.length);
+        put(secrets, OFFSET_PRIVATE_KEY, privateKey, 32);
 
-        final GroupElement P = curveSpec.getB().scalarMultiply(this.privateKey);
+        final GroupElement P = curveSpec.getB().scalarMultiply(privateKey);
 
-        byte[] passwordTmp = getHash("SHA-512", password);  // 64 byte
-        System.arraycopy(passwordTmp, 0, this.passwordHash, 0, this.passwordHash.length);
+        MessageDigest passwordSha = getSha512();
+        passwordSha.update(password);
+        byte[] passwordTmp = passwordSha.digest();  // 64 byte
+        put(secrets, OFFSET_PASSWORD_HASH, passwordTmp, 64);
 
         /**
          * Due to a copy-paste error, the call to {@link #leftShift3(byte[])} was omitted after reducing it, just above.
-         * This meant that {@link #passwordScalar} was not a multiple of eight to clear the cofactor and thus three bits
+         * This meant that the password scalar was not a multiple of eight to clear the cofactor and thus three bits
          * of the password hash would leak. In order to fix this in a unilateral way, points of small order are added to
          * the mask point such as that it is in the prime-order subgroup. Since the ephemeral scalar is a multiple of
          * eight, these points will cancel out when calculating the shared secret.
          *
          * Adding points of small order is the same as adding multiples of the prime order to the password scalar. Since
-         * that's faster, this what is done below. {@link #l} is a large prime, thus, odd, thus the LSB is one. So,
-         * adding it will flip the LSB. Adding twice, it will flip the next bit, and so on for all the bottom three bits.
-         */
-        Scalar passwordScalar = new Scalar(scalarOps.reduce(passwordTmp));
-
-        /**
-         * passwordScalar is the result of scalar reducing and thus is, at most, $l-1$. In the following, we may add
-         * $l+2×l+4×l$ for a max value of $8×l-1$. That is less than $2^256$ as required.
+         * that's faster, this what is done below, see {@link #addMultipleOfOrder(byte[])}.
          */
+        byte[] passwordScalar = scalarOps.reduce(passwordTmp);
 
-        if (!this.disablePasswordScalarHack) {
-            Scalar order = new Scalar(l);
-            Scalar tmp = new Scalar();
-            tmp.copy(order.cmov(tmp, isEqual(passwordScalar.getByte(0) & 1, 1)));
-            passwordScalar.copy(passwordScalar.add(tmp));
-            order.copy(order.dbl());
-
-            tmp.reset();
-            tmp.copy(order.cmov(tmp, isEqual(passwordScalar.getByte(0) & 2, 2)));
-            passwordScalar.copy(passwordScalar.add(tmp));
-            order.copy(order.dbl());
-
-            tmp.reset();
-            tmp.copy(order.cmov(tmp, isEqual(passwordScalar.getByte(0) & 4, 4)));
-            passwordScalar.copy(passwordScalar.add(tmp));
-
-            assert ((passwordScalar.getByte(0) & 7) == 0);
+        if (!disablePasswordScalarHack) {
+            addMultipleOfOrder(passwordScalar);
+            assert ((passwordScalar[0] & 7) == 0);
         }
 
-        System.arraycopy(passwordScalar.getBytes(), 0, this.passwordScalar, 0, this.passwordScalar.length);
+        put(secrets, OFFSET_PASSWORD_SCALAR, passwordScalar, 32);
 
         // mask = h(password) * <N or M>.
-        GroupElement mask = geScalarMultiplySmallPrecomp(curveSpec.getCurve(), this.passwordScalar,
-                this.myRole == Spake2Role.Alice ? SPAKE_M_SMALL_PRECOMP : SPAKE_N_SMALL_PRECOMP);
+        GroupElement mask = geScalarMultiplySmallPrecomp(curveSpec.getCurve(), passwordScalar, 0,
+                myRole == Spake2Role.Alice ? SPAKE_M_SMALL_PRECOMP : SPAKE_N_SMALL_PRECOMP);
+        Arrays.fill(passwordTmp, (byte) 0);
+        Arrays.fill(passwordScalar, (byte) 0);
 
         // P* = P + mask.
         GroupElement PStar = P.add(mask.toCached()).toP2();
 
-        System.arraycopy(PStar.toByteArray(), 0, this.myMsg, 0, this.myMsg.length);
-        this.state = State.MsgGenerated;
-        return this.myMsg.clone();
+        put(secrets, OFFSET_MY_MSG, PStar.toByteArray(), MAX_MSG_SIZE);
     }
 
     /**
-     * @param theirMsg Message generated/received from the other end.
-     * @return Key of size {@link #MAX_KEY_SIZE}.
+     * Derives the key from the peer's message and the state saved by
+     * {@link #computeMessage(Spake2Role, boolean, ByteBuffer, byte[], ByteBuffer)}.
+     *
+     * @param names    Contains both the names at the given offsets, read in place
+     * @param secrets  The secrets as laid out by
+     *                 {@link #computeMessage(Spake2Role, boolean, ByteBuffer, byte[], ByteBuffer)}
+     * @param theirMsg The 32 bytes at the position are read in place, and the position is advanced past them
+     * @param keyOut   The key of size {@link #MAX_KEY_SIZE} is written at the position, which is advanced
      * @throws IllegalArgumentException If the message is invalid or SHA-512 is unavailable for some reason.
-     * @throws IllegalStateException    If the key has already been generated.
      */
-    public byte[] processMessage(final byte[] theirMsg) throws IllegalArgumentException, IllegalStateException {
-        if (isDestroyed) {
-            throw new IllegalStateException("The context was destroyed.");
-        }
-        if (this.state != State.MsgGenerated) {
-            throw new IllegalStateException("Invalid state: " + this.state);
-        }
-        if (theirMsg.length != 32) {
-            throw new IllegalArgumentException("Peer's message is not 32 bytes");
-        }
-
-        GroupElement QStar = curveSpec.getCurve().fromBytesNegateVarTime(theirMsg);
+    static void computeKey(Spake2Role myRole, final ByteBuffer names, int myNameOff, int myNameLen, int theirNameOff,
+                           int theirNameLen, final ByteBuffer secrets, ByteBuffer theirMsg, ByteBuffer keyOut)
+            throws IllegalArgumentException {
+        final int theirMsgOff = theirMsg.position();
+        Curve curve = Ed25519.getSpec().getCurve();
+        GroupElement QStar = curve.fromBytesNegateVarTime(theirMsg, theirMsgOff);
         if (QStar == null) {
             throw new IllegalArgumentException("Point received from peer was not on the curve.");
         }
 
-        System.out.printf("Q*(%s): %s%n", myRole, Utils.bytesToHex(QStar.toByteArray()));
-
         // Unmask peer's value.
-        GroupElement peersMask = geScalarMultiplySmallPrecomp(curveSpec.getCurve(), this.passwordScalar,
-                this.myRole == Spake2Role.Alice ? SPAKE_N_SMALL_PRECOMP : SPAKE_M_SMALL_PRECOMP);
-
-        System.out.printf("PEER'S MASK(%s): %s%n", myRole, Utils.bytesToHex(peersMask.toByteArray()));
+        GroupElement peersMask = geScalarMultiplySmallPrecomp(curve, secrets, OFFSET_PASSWORD_SCALAR,
+                myRole == Spake2Role.Alice ? SPAKE_N_SMALL_PRECOMP : SPAKE_M_SMALL_PRECOMP);
 
         GroupElement QExt = QStar.sub(peersMask.toCached()).toP3();
-        // FIXME: Create a single precomp converter or fix generating single precompute
-        GroupElement QPrecomp = new GroupElement(QExt.getCurve(), GroupElement.Representation.P3, QExt.getX(),
-                QExt.getY(), QExt.getZ(), QExt.getT(), true, true);
 
-        System.out.printf("QExt(%s): %s%n", myRole, Utils.bytesToHex(QExt.toByteArray()));
+        // Only the encoding of the shared point is needed, so the x-only ladder is used instead of precomputing a
+        // table for a point which is used only once.
+        byte[] dhShared = MONTGOMERY_LADDER.scalarMultiply(QExt, secrets, OFFSET_PRIVATE_KEY);
 
-        byte[] dhShared = QPrecomp.scalarMultiply(this.privateKey).toByteArray();
-
-        System.out.printf("DH(%s): %s%n", myRole, Utils.bytesToHex(dhShared));
-
-        MessageDigest sha;
-        try {
-            sha = MessageDigest.getInstance("SHA-512");
-        } catch (NoSuchAlgorithmException e) {
-            throw new IllegalArgumentException("SHA-512 algorithm is not supported.");
-        }
-        if (this.myRole == Spake2Role.Alice) {
-            updateWithLengthPrefix(sha, this.myName, this.myName.length);
-            updateWithLengthPrefix(sha, this.theirName, this.theirName.length);
-            updateWithLengthPrefix(sha, this.myMsg, this.myMsg.length);
-            updateWithLengthPrefix(sha, theirMsg, 32);
+        MessageDigest sha = getSha512();
+        if (myRole == Spake2Role.Alice) {
+            updateWithLengthPrefix(sha, names, myNameOff, myNameLen);
+            updateWithLengthPrefix(sha, names, theirNameOff, theirNameLen);
+            updateWithLengthPrefix(sha, secrets, OFFSET_MY_MSG, MAX_MSG_SIZE);
+            updateWithLengthPrefix(sha, theirMsg, theirMsgOff, 32);
         } else { // Bob
-            updateWithLengthPrefix(sha, this.theirName, this.theirName.length);
-            updateWithLengthPrefix(sha, this.myName, this.myName.length);
-            updateWithLengthPrefix(sha, theirMsg, 32);
-            updateWithLengthPrefix(sha, this.myMsg, this.myMsg.length);
+            updateWithLengthPrefix(sha, names, theirNameOff, theirNameLen);
+            updateWithLengthPrefix(sha, names, myNameOff, myNameLen);
+            updateWithLengthPrefix(sha, theirMsg, theirMsgOff, 32);
+            updateWithLengthPrefix(sha, secrets, OFFSET_MY_MSG, MAX_MSG_SIZE);
         }
-        updateWithLengthPrefix(sha, dhShared, dhShared.length);
-        updateWithLengthPrefix(sha, this.passwordHash, this.passwordHash.length);
+        updateWithLengthPrefix(sha, dhShared, 0, dhShared.length);
+        updateWithLengthPrefix(sha, secrets, OFFSET_PASSWORD_HASH, 64);
 
-        byte[] key = sha.digest();
-        this.state = State.KeyGenerated;
+        // Heap buffers receive the digest in place
+        try {
+            if (keyOut.hasArray()) {
+                sha.digest(keyOut.array(), keyOut.arrayOffset() + keyOut.position(), MAX_KEY_SIZE);
+                ((Buffer) keyOut).position(keyOut.position() + MAX_KEY_SIZE);
+            } else {
+                keyOut.put(sha.digest());
+            }
+        } catch (DigestException e) {
+            throw new IllegalArgumentException(e);
+        }
+        ((Buffer) theirMsg).position(theirMsgOff + 32);
+    }
 
-        return key.clone();
+    /**
+     * @return The message as a buffer for {@link #computeKey}.
+     * @throws IllegalArgumentException If the message is not 32 bytes.
+     */
+    static ByteBuffer wrapMessage(final byte[] theirMsg) throws IllegalArgumentException {
+        if (theirMsg.length != 32) {
+            throw new IllegalArgumentException("Peer's message is not 32 bytes");
+        }
+        return ByteBuffer.wrap(theirMsg);
     }
 
     /**
@@ -493,7 +607,7 @@ public class Spake2Context implements Destroyable {
      *
      * @param n 32 bytes value
      */
-    private static void leftShift3(byte[] n) {
+    static void leftShift3(byte[] n) {
         int carry = 0;
         for (int i = 0; i < 32; i++) {
             int next_carry = (byte) ((n[i] & 0xFF) >>> 5);
@@ -507,8 +621,52 @@ public class Spake2Context implements Destroyable {
      */
     private static final byte[] l = Utils.hexToBytes("edd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010");
 
+    /**
+     * Adds the multiple of {@link #l} in $[0, 8×l)$ that makes the given scalar a multiple of eight. Constant time.
+     * <p>
+     * $l ≡ 5 \pmod 8$ and $5×5 ≡ 1 \pmod 8$, thus $s + k×l ≡ 0 \pmod 8$ for $k = -5×s \bmod 8$. This is the same
+     * as conditionally adding $l$, $2×l$ and $4×l$ one bit at a time.
+     *
+     * @param s 32 bytes scalar less than {@link #l}. Since $8×l-1 \lt 2^256$, the result fits in 32 bytes.
+     */
+    static void addMultipleOfOrder(byte[] s) {
+        final int k = (-5 * (s[0] & 7)) & 7;
+        int carry = 0;
+        for (int i = 0; i < 32; ++i) {
+            carry += (s[i] & 0xFF) + k * (l[i] & 0xFF);
+            s[i] = (byte) carry;
+            carry >>>= 8;
+        }
+    }
+
+
+    /**
+     * Absolute bulk put, which {@link ByteBuffer} only has since Java 13. The position of the buffer is not changed.
+     */
+    static void put(ByteBuffer dst, int index, final byte[] src, int len) {
+        ByteBuffer view = dst.duplicate();
+        ((Buffer) view).position(index);
+        view.put(src, 0, len);
+    }
+
+    static void updateWithLengthPrefix(MessageDigest sha, final byte[] data, int off, int len) {
+        updateLength(sha, len);
+        sha.update(data, off, len);
+    }
 
-    private static void updateWithLengthPrefix(MessageDigest sha, final byte[] data, int len) {
+    /**
+     * Same as {@link #updateWithLengthPrefix(MessageDigest, byte[], int, int)}, but reads the buffer in place without
+     * changing its position.
+     */
+    static void updateWithLengthPrefix(MessageDigest sha, final ByteBuffer data, int off, int len) {
+        ByteBuffer slice = data.duplicate();
+        ((Buffer) slice).limit(off + len);
+        ((Buffer) slice).position(off);
+        updateLength(sha, len);
+        sha.update(slice);
+    }
+
+    private static void updateLength(MessageDigest sha, int len) {
         byte[] len_le = new byte[8];
         long l = len;
         int i;
@@ -519,22 +677,30 @@ public class Spake2Context implements Destroyable {
         }
 
         sha.update(len_le);
-        sha.update(data);
     }
 
-    private GroupElement geScalarMultiplySmallPrecomp(Curve curve,
-                                                      final byte[] a /* 32 bytes */,
-                                                      final GroupElement[] precompTable) {
+    static GroupElement geScalarMultiplySmallPrecomp(Curve curve,
+                                                     final byte[] a /* 32 bytes from off */,
+                                                     int off,
+                                                     final GroupElement[] precompTable) {
+        return geScalarMultiplySmallPrecomp(curve, ByteBuffer.wrap(a), off, precompTable);
+    }
+
+    static GroupElement geScalarMultiplySmallPrecomp(Curve curve,
+                                                     final ByteBuffer a /* 32 bytes from off */,
+                                                     int off,
+                                                     final GroupElement[] precompTable) {
         GroupElement h = curve.getZero(GroupElement.Representation.P3);
         // This loop does 64 additions and 64 doublings to calculate the result.
         for (long i = 63; i >= 0; i--) {
             int index = 0;
 
             for (long j = 0; j < 4; j++) {
-                byte bit = (byte) (1 & (a[(int) ((8 * j) + (i >>> 3))] >>> (i & 7)));
+                byte bit = (byte) (1 & (a.get((int) (off + (8 * j) + (i >>> 3))) >>> (i & 7)));
                 index |= (bit << j);
             }
 
+            if (KernelProfiler.ENABLED) KernelProfiler.count(KernelProfiler.Kernel.TABLE_SELECT);
             GroupElement e = curve.getZero(GroupElement.Representation.PRECOMP);
             for (int j = 1; j < 16; j++) {
                 e = e.cmov(precompTable[j - 1], Utils.equal(index, j));
@@ -545,6 +711,20 @@ public class Spake2Context implements Destroyable {
         return h;
     }
 
+    /**
+     * @return A new SHA-512 instance.
+     * @throws IllegalArgumentException If SHA-512 is unavailable for some reason.
+     */
+    // Package private for testing
+    static MessageDigest getSha512() throws IllegalArgumentException {
+        if (KernelProfiler.ENABLED) KernelProfiler.count(KernelProfiler.Kernel.SHA512);
+        try {
+            return MessageDigest.getInstance("SHA-512");
+        } catch (NoSuchAlgorithmException e) {
+            throw new IllegalArgumentException("SHA-512 algorithm is not supported.");
+        }
+    }
+
     // Package private for testing
     static byte[] getHash(String algo, byte[] bytes) throws IllegalArgumentException {
         MessageDigest md;
@@ -557,114 +737,9 @@ public class Spake2Context implements Destroyable {
         return md.digest(bytes);
     }
 
-    /**
-     * @param a 32 bit value
-     * @param b 32 bit value
-     * @return 0xff...f if a == b and 0x0 otherwise.
-     */
-    private static long isEqual(long a, long b) {
-        return isZero(a ^ b);
-    }
-
-    /**
-     * @param a 32 bit value
-     * @return 0xff...f if a == 0 and 0x0 otherwise.
-     */
-    private static long isZero(long a) {
-        return copyMsbToEveryBit(~a & (a - 1));
-    }
-
-    /**
-     * @param a 32 bit value
-     * @return The given value with the MSB copied to all the other bits.
-     */
-    private static long copyMsbToEveryBit(long a) {
-        // 2's complement of MSB
-        return -(a >>> 63);
-    }
-
     private enum State {
         Init,
         MsgGenerated,
         KeyGenerated,
     }
-
-    static class Scalar {
-        private final byte[] bytes;
-
-        public Scalar(byte[] bytes) {
-            this.bytes = new byte[32];
-            System.arraycopy(bytes, 0, this.bytes, 0, 32);
-        }
-
-        public Scalar() {
-            this.bytes = new byte[32];
-        }
-
-        public byte getByte(int idx) {
-            return bytes[idx];
-        }
-
-        public byte[] getBytes() {
-            return bytes;
-        }
-
-        public void reset() {
-            Arrays.fill(this.bytes, (byte) 0);
-        }
-
-        /**
-         * Copy bytes from the given scalar
-         */
-        public void copy(Scalar scalar) {
-            System.arraycopy(scalar.bytes, 0, this.bytes, 0, 32);
-        }
-
-        /**
-         * @return A new scalar with bits copied from this if the mask is all ones.
-         */
-        public Scalar cmov(Scalar src, long mask) {
-            byte[] m = new byte[4];
-            m[0] = (byte) mask;
-            m[1] = (byte) (mask >>> 8);
-            m[2] = (byte) (mask >>> 16);
-            m[3] = (byte) (mask >>> 24);
-            byte[] bytes = new byte[32];
-            for (int i = 0; i < 8; ++i) {
-                int idx = i * 4;
-                for (int j = 0; j < 4; ++j) {
-                    bytes[idx + j] = (byte) (m[j] & this.bytes[idx + j] | (~m[j] & src.bytes[idx + j]));
-                }
-            }
-            return new Scalar(bytes);
-        }
-
-        /**
-         * @return 2 * this
-         */
-        Scalar dbl() {
-            byte[] bytes = new byte[32];
-            int carry = 0;
-            for (int i = 0; i < 32; ++i) {
-                int carry_out = (this.bytes[i] & 0xFF) >>> 7;
-                bytes[i] = (byte) ((this.bytes[i] << 1) | carry);
-                carry = carry_out;
-            }
-            return new Scalar(bytes);
-        }
-
-        /**
-         * @return src + this
-         */
-        Scalar add(Scalar src) {
-            byte[] bytes = new byte[32];
-            int carry = 0;
-            for (int i = 0; i < 32; ++i) {
-                int tmp = (src.bytes[i] & 0xFF) + (this.bytes[i] & 0xFF) + carry;
-                bytes[i] = (byte) tmp;
-                carry = tmp >>> 8;
-            }
-            return new Scalar(bytes);
-        }
-    }
 }
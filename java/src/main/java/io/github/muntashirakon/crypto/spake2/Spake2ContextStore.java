@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+package io.github.muntashirakon.crypto.spake2;
+
+import java.nio.Buffer;
+import java.nio.ByteBuffer;
+import java.security.SecureRandom;
+import java.util.Arrays;
+
+import javax.security.auth.Destroyable;
+
+import static io.github.muntashirakon.crypto.spake2.Spake2Context.MAX_MSG_SIZE;
+
+/**
+ * A fixed-capacity store of SPAKE2 contexts meant for servers with a large number of pending handshakes.
+ * <p>
+ * Unlike {@link Spake2Context}, the state of every handshake (role, state, scalars, hashes, message and names) lives in
+ * a fixed-size slot of a single direct {@link ByteBuffer}, and is operated on in place. Thus, the garbage collector
+ * only ever sees one large object no matter how many handshakes are pending.
+ * <p>
+ * A context is referred to by the handle returned by {@link #allocate(Spake2Role, byte[], byte[])}, which is the slot
+ * index tagged with the generation of the slot. The generation changes every time the slot is allocated, so a handle
+ * becomes invalid once {@link #free(long)} is called even though the slot is handed out again right away.
+ * <p>
+ * This class is not thread-safe.
+ */
+@SuppressWarnings("unused")
+public class Spake2ContextStore implements Destroyable {
+    private static final byte STATE_FREE = 0;
+    private static final byte STATE_INIT = 1;
+    private static final byte STATE_MSG_GENERATED = 2;
+    private static final byte STATE_KEY_GENERATED = 3;
+
+    private static final byte FLAG_DISABLE_PASSWORD_SCALAR_HACK = 1;
+
+    // Slot layout
+    private static final int OFFSET_STATE = 0;
+    private static final int OFFSET_ROLE = 1;
+    private static final int OFFSET_FLAGS = 2;
+    private static final int OFFSET_MY_NAME_LEN = 4;  // short
+    private static final int OFFSET_THEIR_NAME_LEN = 6;  // short
+    private static final int OFFSET_NEXT_FREE = 8;  // int, only used while the slot is free
+    private static final int OFFSET_GENERATION = 12;  // int, kept when the slot is freed
+    // Secrets as laid out by Spake2Context
+    private static final int OFFSET_SECRETS = 16;
+    private static final int OFFSET_NAMES = OFFSET_SECRETS + Spake2Context.SECRETS_SIZE;
+
+    private final ByteBuffer store;
+    private final int capacity;
+    private final int maxNameLength;
+    private final int slotSize;
+
+    private int freeHead;
+    private int size;
+    private boolean isDestroyed = false;
+
+    /**
+     * @param capacity      Maximum number of contexts alive at the same time.
+     * @param maxNameLength Maximum length of each of the names.
+     */
+    public Spake2ContextStore(int capacity, int maxNameLength) {
+        if (capacity <= 0) {
+            throw new IllegalArgumentException("Invalid capacity " + capacity);
+        }
+        if (maxNameLength < 0 || maxNameLength > Short.MAX_VALUE) {
+            throw new IllegalArgumentException("Invalid maximum name length " + maxNameLength);
+        }
+        // Keep slots 16-byte aligned
+        this.slotSize = (OFFSET_NAMES + 2 * maxNameLength + 15) & ~15;
+        if ((long) capacity * slotSize > Integer.MAX_VALUE) {
+            throw new IllegalArgumentException("Capacity " + capacity + " is too large");
+        }
+        this.capacity = capacity;
+        this.maxNameLength = maxNameLength;
+        this.store = ByteBuffer.allocateDirect(capacity * slotSize);
+        for (int i = 0; i < capacity; ++i) {
+            store.putInt(i * slotSize + OFFSET_NEXT_FREE, i + 1);
+        }
+        this.freeHead = 0;
+        this.size = 0;
+    }
+
+    public int getCapacity() {
+        return capacity;
+    }
+
+    public int getMaxNameLength() {
+        return maxNameLength;
+    }
+
+    /**
+     * @return Number of contexts currently allocated.
+     */
+    public int size() {
+        return size;
+    }
+
+    // Package private for testing
+    int getSlotSize() {
+        return slotSize;
+    }
+
+    /**
+     * Allocates a new context.
+     *
+     * @return The handle to the new context.
+     * @throws IllegalArgumentException If any of the names is longer than {@link #getMaxNameLength()}.
+     * @throws IllegalStateException    If the store is full or destroyed.
+     */
+    public long allocate(Spake2Role myRole,
+                        final byte[] myName,
+                        final byte[] theirName) throws IllegalArgumentException, IllegalStateException {
+        if (isDestroyed) {
+            throw new IllegalStateException("The store was destroyed.");
+        }
+        if (myName.length > maxNameLength || theirName.length > maxNameLength) {
+            throw new IllegalArgumentException("Names must not be longer than " + maxNameLength + " bytes");
+        }
+        if (freeHead == capacity) {
+            throw new IllegalStateException("No free slot left");
+        }
+        int index = freeHead;
+        int base = index * slotSize;
+        int generation = store.getInt(base + OFFSET_GENERATION) + 1;
+        freeHead = store.getInt(base + OFFSET_NEXT_FREE);
+        ++size;
+
+        store.put(base + OFFSET_STATE, STATE_INIT);
+        store.put(base + OFFSET_ROLE, (byte) myRole.ordinal());
+        store.put(base + OFFSET_FLAGS, (byte) 0);
+        store.putShort(base + OFFSET_MY_NAME_LEN, (short) myName.length);
+        store.putShort(base + OFFSET_THEIR_NAME_LEN, (short) theirName.length);
+        store.putInt(base + OFFSET_NEXT_FREE, 0);
+        store.putInt(base + OFFSET_GENERATION, generation);
+        Spake2Context.put(store, base + OFFSET_NAMES, myName, myName.length);
+        Spake2Context.put(store, base + OFFSET_NAMES + maxNameLength, theirName, theirName.length);
+        return ((long) generation << 32) | index;
+    }
+
+    /**
+     * Zeroes the context and returns its slot to the store. The handle must not be used afterwards.
+     */
+    public void free(long ctx) throws IllegalStateException {
+        int base = checkedBase(ctx);
+        int generation = store.getInt(base + OFFSET_GENERATION);
+        for (int i = 0; i < slotSize; ++i) {
+            store.put(base + i, (byte) 0);
+        }
+        store.putInt(base + OFFSET_GENERATION, generation);
+        store.putInt(base + OFFSET_NEXT_FREE, freeHead);
+        freeHead = (int) ctx;
+        --size;
+    }
+
+    public void setDisablePasswordScalarHack(long ctx, boolean disablePasswordScalarHack) throws IllegalStateException {
+        int base = checkedBase(ctx);
+        store.put(base + OFFSET_FLAGS, disablePasswordScalarHack ? FLAG_DISABLE_PASSWORD_SCALAR_HACK : 0);
+    }
+
+    public boolean isDisablePasswordScalarHack(long ctx) throws IllegalStateException {
+        int base = checkedBase(ctx);
+        return (store.get(base + OFFSET_FLAGS) & FLAG_DISABLE_PASSWORD_SCALAR_HACK) != 0;
+    }
+
+    public Spake2Role getMyRole(long ctx) throws IllegalStateException {
+        return Spake2Role.values()[store.get(checkedBase(ctx) + OFFSET_ROLE)];
+    }
+
+    /**
+     * @param password Shared password.
+     * @return A message of size {@link Spake2Context#MAX_MSG_SIZE}.
+     * @throws IllegalArgumentException If SHA-512 is unavailable for some reason.
+     * @throws IllegalStateException    If the handle is invalid or the message has already been generated.
+     */
+    public byte[] generateMessage(long ctx, final byte[] password) throws IllegalArgumentException, IllegalStateException {
+        byte[] privateKey = new byte[64];
+        new SecureRandom().nextBytes(privateKey);
+        return generateMessage(ctx, password, privateKey);
+    }
+
+    // Package private method for testing purposes
+    byte[] generateMessage(long ctx, final byte[] password, byte[] privateKey) throws IllegalArgumentException, IllegalStateException {
+        int base = checkedBase(ctx);
+        if (store.get(base + OFFSET_STATE) != STATE_INIT) {
+            throw new IllegalStateException("Invalid state: " + store.get(base + OFFSET_STATE));
+        }
+
+        ByteBuffer secrets = view(base + OFFSET_SECRETS, Spake2Context.SECRETS_SIZE);
+        try {
+            Spake2Context.computeMessage(getMyRole(ctx),
+                    (store.get(base + OFFSET_FLAGS) & FLAG_DISABLE_PASSWORD_SCALAR_HACK) != 0,
+                    ByteBuffer.wrap(password), privateKey, secrets);
+        } finally {
+            Arrays.fill(privateKey, (byte) 0);
+        }
+        store.put(base + OFFSET_STATE, STATE_MSG_GENERATED);
+        byte[] myMsg = new byte[MAX_MSG_SIZE];
+        ((Buffer) secrets).position(Spake2Context.OFFSET_MY_MSG);
+        secrets.get(myMsg);
+        return myMsg;
+    }
+
+    /**
+     * @param theirMsg Message generated/received from the other end.
+     * @return Key of size {@link Spake2Context#MAX_KEY_SIZE}.
+     * @throws IllegalArgumentException If the message is invalid or SHA-512 is unavailable for some reason.
+     * @throws IllegalStateException    If the handle is invalid or the key has already been generated.
+     */
+    public byte[] processMessage(long ctx, final byte[] theirMsg) throws IllegalArgumentException, IllegalStateException {
+        int base = checkedBase(ctx);
+        if (store.get(base + OFFSET_STATE) != STATE_MSG_GENERATED) {
+            throw new IllegalStateException("Invalid state: " + store.get(base + OFFSET_STATE));
+        }
+
+        int myNameLen = store.getShort(base + OFFSET_MY_NAME_LEN);
+        int theirNameLen = store.getShort(base + OFFSET_THEIR_NAME_LEN);
+        byte[] key = new byte[Spake2Context.MAX_KEY_SIZE];
+        Spake2Context.computeKey(getMyRole(ctx), view(base + OFFSET_NAMES, 2 * maxNameLength), 0, myNameLen,
+                maxNameLength, theirNameLen, view(base + OFFSET_SECRETS, Spake2Context.SECRETS_SIZE),
+                Spake2Context.wrapMessage(theirMsg), ByteBuffer.wrap(key));
+        store.put(base + OFFSET_STATE, STATE_KEY_GENERATED);
+        return key;
+    }
+
+    @Override
+    public boolean isDestroyed() {
+        return isDestroyed;
+    }
+
+    /**
+     * Zeroes every context. All handles become invalid.
+     */
+    @Override
+    public void destroy() {
+        isDestroyed = true;
+        for (int i = 0; i < store.capacity(); ++i) {
+            store.put(i, (byte) 0);
+        }
+    }
+
+    /**
+     * @return The base of the slot of the context.
+     * @throws IllegalStateException If the handle is invalid or stale, i.e. the slot was freed since.
+     */
+    private int checkedBase(long ctx) throws IllegalStateException {
+        if (isDestroyed) {
+            throw new IllegalStateException("The store was destroyed.");
+        }
+        int index = (int) ctx;
+        int generation = (int) (ctx >>> 32);
+        if (index < 0 || index >= capacity) {
+            throw new IllegalStateException("Invalid context " + ctx);
+        }
+        int base = index * slotSize;
+        if (store.get(base + OFFSET_STATE) == STATE_FREE || store.getInt(base + OFFSET_GENERATION) != generation) {
+            throw new IllegalStateException("Invalid context " + ctx);
+        }
+        return base;
+    }
+
+    /**
+     * @return A view of the given bytes of the store, starting at index 0.
+     */
+    private ByteBuffer view(int offset, int len) {
+        ByteBuffer view = store.duplicate();
+        ((Buffer) view).limit(offset + len);
+        ((Buffer) view).position(offset);
+        return view.slice();
+    }
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+package io.github.muntashirakon.crypto.spake2;
+
+import java.security.MessageDigest;
+import java.security.SecureRandom;
+import java.util.Arrays;
+
+import javax.security.auth.Destroyable;
+
+import io.github.muntashirakon.crypto.ed25519.Curve;
+import io.github.muntashirakon.crypto.ed25519.Ed25519;
+import io.github.muntashirakon.crypto.ed25519.Ed25519CurveParameterSpec;
+import io.github.muntashirakon.crypto.ed25519.GroupElement;
+
+import static io.github.muntashirakon.crypto.spake2.Spake2Context.MAX_KEY_SIZE;
+import static io.github.muntashirakon.crypto.spake2.Spake2Context.MAX_MSG_SIZE;
+import static io.github.muntashirakon.crypto.spake2.Spake2Context.MONTGOMERY_LADDER;
+import static io.github.muntashirakon.crypto.spake2.Spake2Context.SPAKE_M_SMALL_PRECOMP;
+import static io.github.muntashirakon.crypto.spake2.Spake2Context.SPAKE_N_SMALL_PRECOMP;
+
+/**
+ * The augmented variant of SPAKE2, SPAKE2+, where Alice is the client (prover) who knows the password and Bob is the
+ * server (verifier) who only knows the {@link Spake2PlusVerifier} record of the password.
+ * <p>
+ * With $w0$ and $w1$ derived from the password and $L = w1 * B$:
+ * </p><ul>
+ * <li>Alice sends $X = x * B + w0 * M$.
+ * <li>Bob sends $Y = y * B + w0 * N$.
+ * <li>Alice computes $Z = x * (Y - w0 * N)$ and $V = w1 * (Y - w0 * N)$.
+ * <li>Bob computes $Z = y * (X - w0 * M)$ and $V = y * L$.
+ * <li>Both derive the key from the names, $X$, $Y$, $Z$, $V$ and $w0$.
+ * </ul><p>
+ * $x$ and $y$ are multiples of the cofactor, and so is the scalar used for $w1$ (see
+ * {@link Spake2Context#addMultipleOfOrder(byte[])}), so that points of small order sent by the peer are cleared.
+ * Bob uses the masks stored in the record, so a handshake on his side does not touch the password at all.
+ * <p>
+ * This is a custom construction in the spirit of SPAKE2+, and it does not interoperate with RFC 9383: $w0$ and $w1$
+ * are derived differently (see {@link #deriveScalars(byte[], byte[], byte[])}), $M$ and $N$ are the SPAKE2 points of
+ * this library, and the transcript is hashed as described above. Neither is there any key confirmation: a wrong
+ * password only results in different keys, so the caller must confirm the key (e.g. with a MAC over the transcript)
+ * before trusting it.
+ */
+@SuppressWarnings("unused")
+public class Spake2PlusContext implements Destroyable {
+    private final Spake2Role myRole;
+    private final byte[] myName;
+    private final byte[] theirName;
+    private final byte[] privateKey = new byte[32];
+    private final byte[] myMsg = new byte[MAX_MSG_SIZE];
+    private final byte[] w0 = new byte[32];
+    // Alice only, w1 as a multiple of eight
+    private final byte[] w1 = new byte[32];
+    // Bob only
+    private Spake2PlusVerifier verifier;
+
+    private State state;
+    private boolean isDestroyed = false;
+
+    /**
+     * @param myRole {@link Spake2Role#Alice} for the client, {@link Spake2Role#Bob} for the server.
+     */
+    public Spake2PlusContext(Spake2Role myRole,
+                             final byte[] myName,
+                             final byte[] theirName) {
+        this.myRole = myRole;
+        this.myName = myName.clone();
+        this.theirName = theirName.clone();
+        this.state = State.Init;
+    }
+
+    public Spake2Role getMyRole() {
+        return myRole;
+    }
+
+    public byte[] getMyMsg() {
+        return myMsg.clone();
+    }
+
+    public byte[] getMyName() {
+        return myName.clone();
+    }
+
+    public byte[] getTheirName() {
+        return theirName.clone();
+    }
+
+    @Override
+    public boolean isDestroyed() {
+        return isDestroyed;
+    }
+
+    @Override
+    public void destroy() {
+        isDestroyed = true;
+        Arrays.fill(privateKey, (byte) 0);
+        Arrays.fill(w0, (byte) 0);
+        Arrays.fill(w1, (byte) 0);
+        verifier = null;
+    }
+
+    /**
+     * Generates the message of Alice, the client.
+     *
+     * @param password Shared password, the same as the one given to {@link Spake2PlusVerifier#fromPassword(byte[])}.
+     * @return A message of size {@link Spake2Context#MAX_MSG_SIZE}.
+     * @throws IllegalArgumentException If SHA-512 is unavailable for some reason.
+     * @throws IllegalStateException    If this is not Alice or the message has already been generated.
+     */
+    public byte[] generateMessage(final byte[] password) throws IllegalArgumentException, IllegalStateException {
+        byte[] privateKey = new byte[64];
+        new SecureRandom().nextBytes(privateKey);
+        return generateMessage(password, privateKey);
+    }
+
+    /**
+     * Generates the message of Bob, the server.
+     *
+     * @param verifier The record of the password.
+     * @return A message of size {@link Spake2Context#MAX_MSG_SIZE}.
+     * @throws IllegalStateException If this is not Bob or the message has already been generated.
+     */
+    public byte[] generateMessage(Spake2PlusVerifier verifier) throws IllegalStateException {
+        byte[] privateKey = new byte[64];
+        new SecureRandom().nextBytes(privateKey);
+        return generateMessage(verifier, privateKey);
+    }
+
+    // Package private method for testing purposes
+    byte[] generateMessage(final byte[] password, byte[] privateKey) throws IllegalArgumentException, IllegalStateException {
+        checkState(Spake2Role.Alice, State.Init);
+        deriveScalars(password, w0, w1);
+        Spake2Context.addMultipleOfOrder(w1);
+        // X = x * B + w0 * M
+        GroupElement mask = Spake2Context.geScalarMultiplySmallPrecomp(Ed25519.getSpec().getCurve(), w0, 0,
+                SPAKE_M_SMALL_PRECOMP);
+        computeMessage(privateKey, mask.toCached());
+        return getMyMsg();
+    }
+
+    // Package private method for testing purposes
+    byte[] generateMessage(Spake2PlusVerifier verifier, byte[] privateKey) throws IllegalStateException {
+        checkState(Spake2Role.Bob, State.Init);
+        if (verifier.isDestroyed()) {
+            throw new IllegalStateException("The verifier was destroyed.");
+        }
+        this.verifier = verifier;
+        System.arraycopy(verifier.w0(), 0, w0, 0, 32);
+        // Y = y * B + w0 * N
+        computeMessage(privateKey, verifier.w0N);
+        return getMyMsg();
+    }
+
+    /**
+     * @param theirMsg Message generated/received from the other end.
+     * @return Key of size {@link Spake2Context#MAX_KEY_SIZE}.
+     * @throws IllegalArgumentException If the message is invalid or SHA-512 is unavailable for some reason.
+     * @throws IllegalStateException    If the key has already been generated.
+     */
+    public byte[] processMessage(final byte[] theirMsg) throws IllegalArgumentException, IllegalStateException {
+        checkState(myRole, State.MsgGenerated);
+        if (theirMsg.length != 32) {
+            throw new IllegalArgumentException("Peer's message is not 32 bytes");
+        }
+
+        Curve curve = Ed25519.getSpec().getCurve();
+        GroupElement QStar = curve.fromBytesNegateVarTime(theirMsg);
+        if (QStar == null) {
+            throw new IllegalArgumentException("Point received from peer was not on the curve.");
+        }
+
+        byte[] Z;
+        byte[] V;
+        if (myRole == Spake2Role.Alice) {
+            GroupElement peersMask = Spake2Context.geScalarMultiplySmallPrecomp(curve, w0, 0, SPAKE_N_SMALL_PRECOMP);
+            GroupElement Q = QStar.sub(peersMask.toCached()).toP3();
+            Z = MONTGOMERY_LADDER.scalarMultiply(Q, privateKey);
+            V = MONTGOMERY_LADDER.scalarMultiply(Q, w1);
+        } else { // Bob
+            GroupElement Q = QStar.msub(verifier.w0M).toP3();
+            Z = MONTGOMERY_LADDER.scalarMultiply(Q, privateKey);
+            V = MONTGOMERY_LADDER.scalarMultiply(verifier.getPointL(), privateKey);
+        }
+
+        MessageDigest sha = Spake2Context.getSha512();
+        if (myRole == Spake2Role.Alice) {
+            Spake2Context.updateWithLengthPrefix(sha, myName, 0, myName.length);
+            Spake2Context.updateWithLengthPrefix(sha, theirName, 0, theirName.length);
+            Spake2Context.updateWithLengthPrefix(sha, myMsg, 0, MAX_MSG_SIZE);
+            Spake2Context.updateWithLengthPrefix(sha, theirMsg, 0, 32);
+        } else { // Bob
+            Spake2Context.updateWithLengthPrefix(sha, theirName, 0, theirName.length);
+            Spake2Context.updateWithLengthPrefix(sha, myName, 0, myName.length);
+            Spake2Context.updateWithLengthPrefix(sha, theirMsg, 0, 32);
+            Spake2Context.updateWithLengthPrefix(sha, myMsg, 0, MAX_MSG_SIZE);
+        }
+        Spake2Context.updateWithLengthPrefix(sha, Z, 0, Z.length);
+        Spake2Context.updateWithLengthPrefix(sha, V, 0, V.length);
+        Spake2Context.updateWithLengthPrefix(sha, w0, 0, 32);
+        this.state = State.KeyGenerated;
+
+        byte[] key = sha.digest();
+        assert key.length == MAX_KEY_SIZE;
+        return key;
+    }
+
+    /**
+     * Derives $w0$ and $w1$ from the password: $w0$ is the password hash reduced modulo $l$, the same as the password
+     * scalar of SPAKE2, and $w1$ is the hash of the password hash reduced modulo $l$.
+     *
+     * @param w0 32 bytes output
+     * @param w1 32 bytes output
+     * @throws IllegalArgumentException If SHA-512 is unavailable for some reason.
+     */
+    static void deriveScalars(final byte[] password, byte[] w0, byte[] w1) throws IllegalArgumentException {
+        Ed25519CurveParameterSpec curveSpec = Ed25519.getSpec();
+        byte[] passwordHash = Spake2Context.getSha512().digest(password);
+        System.arraycopy(curveSpec.getScalarOps().reduce(passwordHash), 0, w0, 0, 32);
+        byte[] hash = Spake2Context.getSha512().digest(passwordHash);
+        System.arraycopy(curveSpec.getScalarOps().reduce(hash), 0, w1, 0, 32);
+        Arrays.fill(passwordHash, (byte) 0);
+        Arrays.fill(hash, (byte) 0);
+    }
+
+    /**
+     * @param privateKey 64 random bytes, overwritten during the process
+     * @param mask       $w0 * M$ or $w0 * N$ in CACHED or PRECOMP representation
+     */
+    private void computeMessage(byte[] privateKey, GroupElement mask) {
+        Ed25519CurveParameterSpec curveSpec = Ed25519.getSpec();
+        System.arraycopy(curveSpec.getScalarOps().reduce(privateKey), 0, privateKey, 0, 32);
+        // Multiply by the cofactor so that it's cleared when operating on the peer's point
+        Spake2Context.leftShift3(privateKey);
+        System.arraycopy(privateKey, 0, this.privateKey, 0, 32);
+        Arrays.fill(privateKey, (byte) 0);
+
+        final GroupElement P = curveSpec.getB().scalarMultiply(this.privateKey);
+        final GroupElement PStar = mask.getRepresentation() == GroupElement.Representation.PRECOMP
+                ? P.madd(mask) : P.add(mask);
+        System.arraycopy(PStar.toP2().toByteArray(), 0, myMsg, 0, MAX_MSG_SIZE);
+        this.state = State.MsgGenerated;
+    }
+
+    private void checkState(Spake2Role role, State state) throws IllegalStateException {
+        if (isDestroyed) {
+            throw new IllegalStateException("The context was destroyed.");
+        }
+        if (myRole != role) {
+            throw new IllegalStateException("Only " + role + " can do this.");
+        }
+        if (this.state != state) {
+            throw new IllegalStateException("Invalid state: " + this.state);
+        }
+    }
+
+    private enum State {
+        Init,
+        MsgGenerated,
+        KeyGenerated,
+    }
+}
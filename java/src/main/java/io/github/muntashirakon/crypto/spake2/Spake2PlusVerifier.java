@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+package io.github.muntashirakon.crypto.spake2;
+
+import java.nio.ByteBuffer;
+import java.util.Arrays;
+
+import javax.security.auth.Destroyable;
+
+import io.github.muntashirakon.crypto.ed25519.Curve;
+import io.github.muntashirakon.crypto.ed25519.Ed25519;
+import io.github.muntashirakon.crypto.ed25519.Ed25519CurveParameterSpec;
+import io.github.muntashirakon.crypto.ed25519.Ed25519Field;
+import io.github.muntashirakon.crypto.ed25519.FieldElement;
+import io.github.muntashirakon.crypto.ed25519.GroupElement;
+
+/**
+ * The verifier record of a password that is stored by the server (Bob) in the augmented {@link Spake2PlusContext}
+ * mode: $w0$ and $L = w1 * B$, which does not reveal the password (or $w1$) without an offline dictionary attack.
+ * <p>
+ * Besides $w0$ and $L$, the record also holds the masks $w0 * M$ and $w0 * N$. All three points are kept in the
+ * affine PRECOMP representation $(y + x, y - x, 2 * d * x * y)$, the same as the entries of the precomputed tables, so
+ * that neither the password nor the points have to be processed again during a handshake. The record has a fixed size
+ * of {@link #RECORD_SIZE} bytes, thus a verifier store can simply be an array of records, e.g. a memory-mapped file.
+ */
+@SuppressWarnings("unused")
+public class Spake2PlusVerifier implements Destroyable {
+    /**
+     * Size of a verifier record in bytes
+     */
+    public static final int RECORD_SIZE = 32 + 3 * 96;
+
+    private final byte[] w0;
+    final GroupElement L;
+    final GroupElement w0M;
+    final GroupElement w0N;
+    private boolean isDestroyed = false;
+
+    private Spake2PlusVerifier(byte[] w0, GroupElement L, GroupElement w0M, GroupElement w0N) {
+        this.w0 = w0;
+        this.L = L;
+        this.w0M = w0M;
+        this.w0N = w0N;
+    }
+
+    /**
+     * Registers a password.
+     *
+     * @param password Shared password. Since the record can be attacked offline, this should be the output of a
+     *                 memory-hard password hashing function such as scrypt or Argon2 rather than the password itself.
+     * @throws IllegalArgumentException If SHA-512 is unavailable for some reason.
+     */
+    public static Spake2PlusVerifier fromPassword(final byte[] password) throws IllegalArgumentException {
+        byte[] w0 = new byte[32];
+        byte[] w1 = new byte[32];
+        try {
+            Spake2PlusContext.deriveScalars(password, w0, w1);
+            Ed25519CurveParameterSpec curveSpec = Ed25519.getSpec();
+            Curve curve = curveSpec.getCurve();
+            return new Spake2PlusVerifier(w0, toPrecomp(curveSpec.getB().scalarMultiply(w1)),
+                    toPrecomp(Spake2Context.geScalarMultiplySmallPrecomp(curve, w0, 0,
+                            Spake2Context.SPAKE_M_SMALL_PRECOMP)),
+                    toPrecomp(Spake2Context.geScalarMultiplySmallPrecomp(curve, w0, 0,
+                            Spake2Context.SPAKE_N_SMALL_PRECOMP)));
+        } finally {
+            Arrays.fill(w1, (byte) 0);
+        }
+    }
+
+    /**
+     * Reads a record written by {@link #writeRecord(ByteBuffer)} at the current position of the buffer, and advances
+     * the position by {@link #RECORD_SIZE}. Each point is checked to be on the curve, as the record may come from an
+     * untrusted medium, e.g. a memory-mapped file. That takes a few field multiplications and no inversion.
+     *
+     * @throws IllegalArgumentException If a point of the record is not on the curve.
+     */
+    public static Spake2PlusVerifier fromRecord(ByteBuffer record) throws IllegalArgumentException {
+        Curve curve = Ed25519.getSpec().getCurve();
+        byte[] w0 = new byte[32];
+        record.get(w0);
+        return new Spake2PlusVerifier(w0, readPrecomp(curve, record), readPrecomp(curve, record),
+                readPrecomp(curve, record));
+    }
+
+    /**
+     * Writes the record of {@link #RECORD_SIZE} bytes at the current position of the buffer, and advances the position.
+     */
+    public void writeRecord(ByteBuffer record) throws IllegalStateException {
+        if (isDestroyed) {
+            throw new IllegalStateException("The verifier was destroyed.");
+        }
+        record.put(w0);
+        writePrecomp(record, L);
+        writePrecomp(record, w0M);
+        writePrecomp(record, w0N);
+    }
+
+    public byte[] toRecord() throws IllegalStateException {
+        byte[] record = new byte[RECORD_SIZE];
+        writeRecord(ByteBuffer.wrap(record));
+        return record;
+    }
+
+    /**
+     * @return $w0$, a 32 bytes scalar.
+     */
+    public byte[] getW0() {
+        return w0.clone();
+    }
+
+    /**
+     * @return The encoded point $L = w1 * B$.
+     */
+    public byte[] getL() {
+        return getPointL().toByteArray();
+    }
+
+    // Package private for Spake2PlusContext
+    byte[] w0() {
+        return w0;
+    }
+
+    /**
+     * @return $L$ in P2 representation, which is all the Montgomery ladder needs. Since the PRECOMP representation is
+     * affine, this needs no inversion: $(X : Y : Z) = ((y + x) - (y - x) : (y + x) + (y - x) : 2)$.
+     */
+    GroupElement getPointL() {
+        FieldElement ypx = L.getX();
+        FieldElement ymx = L.getY();
+        return GroupElement.p2(L.getCurve(), ypx.subtract(ymx), ypx.add(ymx), L.getCurve().getField().TWO);
+    }
+
+    @Override
+    public boolean isDestroyed() {
+        return isDestroyed;
+    }
+
+    @Override
+    public void destroy() {
+        isDestroyed = true;
+        Arrays.fill(w0, (byte) 0);
+    }
+
+    /**
+     * Converts a point in P3 representation to the affine PRECOMP representation using a single inversion.
+     */
+    static GroupElement toPrecomp(GroupElement P) {
+        Curve curve = P.getCurve();
+        FieldElement recip = P.getZ().invert();
+        FieldElement x = P.getX().multiply(recip);
+        FieldElement y = P.getY().multiply(recip);
+        return GroupElement.precomp(curve, y.add(x), y.subtract(x), x.multiply(y).multiply(curve.get2D()));
+    }
+
+    private static GroupElement readPrecomp(Curve curve, ByteBuffer record) {
+        Ed25519Field f = curve.getField();
+        byte[] bytes = new byte[32];
+        record.get(bytes);
+        FieldElement ypx = f.fromByteArray(bytes);
+        record.get(bytes);
+        FieldElement ymx = f.fromByteArray(bytes);
+        record.get(bytes);
+        FieldElement xy2d = f.fromByteArray(bytes);
+        if (!isOnCurve(curve, ypx, ymx, xy2d)) {
+            throw new IllegalArgumentException("Record contains a point that is not on the curve.");
+        }
+        return GroupElement.precomp(curve, ypx, ymx, xy2d);
+    }
+
+    /**
+     * Checks a point in PRECOMP representation $(y + x, y - x, 2 * d * x * y)$ against the curve equation
+     * $-x^2 + y^2 = 1 + d * x^2 * y^2$ and its third coordinate. With $a = 2 * x$ and $b = 2 * y$, these become
+     * $4 * (b^2 - a^2) = 16 + d * a^2 * b^2$ and $2 * (2 * d * x * y) = d * a * b$, which need no inversion.
+     */
+    private static boolean isOnCurve(Curve curve, FieldElement ypx, FieldElement ymx, FieldElement xy2d) {
+        Ed25519Field f = curve.getField();
+        FieldElement a = ypx.subtract(ymx);
+        FieldElement b = ypx.add(ymx);
+        FieldElement aa = a.square();
+        FieldElement bb = b.square();
+        FieldElement four = f.TWO.add(f.TWO);
+        FieldElement lhs = four.multiply(bb.subtract(aa));
+        FieldElement rhs = four.square().add(curve.getD().multiply(aa).multiply(bb));
+        FieldElement dab = curve.getD().multiply(a).multiply(b);
+        return lhs.equals(rhs) && xy2d.add(xy2d).equals(dab);
+    }
+
+    private static void writePrecomp(ByteBuffer record, GroupElement P) {
+        record.put(P.getX().toByteArray());
+        record.put(P.getY().toByteArray());
+        record.put(P.getZ().toByteArray());
+    }
+}
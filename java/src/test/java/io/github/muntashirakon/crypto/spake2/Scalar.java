@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+package io.github.muntashirakon.crypto.spake2;
+
+import java.util.Arrays;
+
+/**
+ * A little-endian 256-bit scalar, kept as a reference for the bit-by-bit password scalar adjustment.
+ */
+class Scalar {
+    private final byte[] bytes;
+
+    public Scalar(byte[] bytes) {
+        this.bytes = new byte[32];
+        System.arraycopy(bytes, 0, this.bytes, 0, 32);
+    }
+
+    public Scalar() {
+        this.bytes = new byte[32];
+    }
+
+    public byte getByte(int idx) {
+        return bytes[idx];
+    }
+
+    public byte[] getBytes() {
+        return bytes;
+    }
+
+    public void reset() {
+        Arrays.fill(this.bytes, (byte) 0);
+    }
+
+    /**
+     * Copy bytes from the given scalar
+     */
+    public void copy(Scalar scalar) {
+        System.arraycopy(scalar.bytes, 0, this.bytes, 0, 32);
+    }
+
+    /**
+     * @return A new scalar with bits copied from this if the mask is all ones.
+     */
+    public Scalar cmov(Scalar src, long mask) {
+        byte[] m = new byte[4];
+        m[0] = (byte) mask;
+        m[1] = (byte) (mask >>> 8);
+        m[2] = (byte) (mask >>> 16);
+        m[3] = (byte) (mask >>> 24);
+        byte[] bytes = new byte[32];
+        for (int i = 0; i < 8; ++i) {
+            int idx = i * 4;
+            for (int j = 0; j < 4; ++j) {
+                bytes[idx + j] = (byte) (m[j] & this.bytes[idx + j] | (~m[j] & src.bytes[idx + j]));
+            }
+        }
+        return new Scalar(bytes);
+    }
+
+    /**
+     * @return 2 * this
+     */
+    Scalar dbl() {
+        byte[] bytes = new byte[32];
+        int carry = 0;
+        for (int i = 0; i < 32; ++i) {
+            int carry_out = (this.bytes[i] & 0xFF) >>> 7;
+            bytes[i] = (byte) ((this.bytes[i] << 1) | carry);
+            carry = carry_out;
+        }
+        return new Scalar(bytes);
+    }
+
+    /**
+     * @return src + this
+     */
+    Scalar add(Scalar src) {
+        byte[] bytes = new byte[32];
+        int carry = 0;
+        for (int i = 0; i < 32; ++i) {
+            int tmp = (src.bytes[i] & 0xFF) + (this.bytes[i] & 0xFF) + carry;
+            bytes[i] = (byte) tmp;
+            carry = tmp >>> 8;
+        }
+        return new Scalar(bytes);
+    }
+}
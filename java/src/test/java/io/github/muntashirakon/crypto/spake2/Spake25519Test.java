@@ -9,7 +9,12 @@ package io.github.muntashirakon.crypto.spake2;
 import org.junit.Test;
 
 import java.math.BigInteger;
+import java.nio.BufferOverflowException;
+import java.nio.BufferUnderflowException;
+import java.nio.ByteBuffer;
+import java.nio.ReadOnlyBufferException;
 import java.nio.charset.StandardCharsets;
+import java.security.SecureRandom;
 import java.util.Arrays;
 
 import io.github.muntashirakon.crypto.ed25519.Curve;
@@ -18,6 +23,8 @@ import io.github.muntashirakon.crypto.ed25519.Ed25519CurveParameterSpec;
 import io.github.muntashirakon.crypto.ed25519.Ed25519Field;
 import io.github.muntashirakon.crypto.ed25519.FieldElement;
 import io.github.muntashirakon.crypto.ed25519.GroupElement;
+import io.github.muntashirakon.crypto.ed25519.KernelProfiler;
+import io.github.muntashirakon.crypto.ed25519.MontgomeryLadder;
 import io.github.muntashirakon.crypto.ed25519.Utils;
 
 import static org.junit.Assert.*;
@@ -117,9 +124,9 @@ public class Spake25519Test {
 
     @Test
     public void scalarTestCmov() {
-        Spake2Context.Scalar scalar = new Spake2Context.Scalar(Utils.hexToBytes(
+        Scalar scalar = new Scalar(Utils.hexToBytes(
                 "edd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010"));
-        Spake2Context.Scalar zero = new Spake2Context.Scalar();
+        Scalar zero = new Scalar();
         assertEquals("0000000000000000000000000000000000000000000000000000000000000000",
                 Utils.bytesToHex(scalar.cmov(zero, 0).getBytes()));
         assertEquals("0100000000000000000000000000000000000000000000000000000000000000",
@@ -138,9 +145,9 @@ public class Spake25519Test {
 
     @Test
     public void scalarTestCmov2() {
-        Spake2Context.Scalar scalar = new Spake2Context.Scalar(Utils.hexToBytes(
+        Scalar scalar = new Scalar(Utils.hexToBytes(
                 "edd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010"));
-        Spake2Context.Scalar base = new Spake2Context.Scalar();
+        Scalar base = new Scalar();
         base.copy(scalar.cmov(base, 0));
         assertEquals("0000000000000000000000000000000000000000000000000000000000000000",
                 Utils.bytesToHex(base.getBytes()));
@@ -166,9 +173,9 @@ public class Spake25519Test {
 
     @Test
     public void scalarTestDbl() {
-        Spake2Context.Scalar scalar = new Spake2Context.Scalar(Utils.hexToBytes(
+        Scalar scalar = new Scalar(Utils.hexToBytes(
                 "edd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010"));
-        Spake2Context.Scalar eight = new Spake2Context.Scalar(B_EIGHT);
+        Scalar eight = new Scalar(B_EIGHT);
         assertEquals("daa7ebb934c624b0ac39ef45bdf3bd2900000000000000000000000000000020",
                 Utils.bytesToHex(scalar.dbl().getBytes()));
         assertEquals("1000000000000000000000000000000000000000000000000000000000000000",
@@ -180,15 +187,77 @@ public class Spake25519Test {
 
     @Test
     public void scalarTestAdd() {
-        Spake2Context.Scalar scalar = new Spake2Context.Scalar(Utils.hexToBytes(
+        Scalar scalar = new Scalar(Utils.hexToBytes(
                 "edd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010"));
-        Spake2Context.Scalar eight = new Spake2Context.Scalar(B_EIGHT);
+        Scalar eight = new Scalar(B_EIGHT);
         assertEquals("f5d3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010",
                 Utils.bytesToHex(eight.add(scalar).getBytes()));
         assertEquals("daa7ebb934c624b0ac39ef45bdf3bd2900000000000000000000000000000020",
                 Utils.bytesToHex(scalar.add(scalar).getBytes()));
     }
 
+    @Test
+    public void scalarOpsMatchBigInteger() {
+        Ed25519CurveParameterSpec spec = Ed25519.getSpec();
+        BigInteger l = BigInteger.ONE.shiftLeft(252).add(new BigInteger("27742317777372353535851937790883648493"));
+        SecureRandom random = new SecureRandom();
+        byte[] s = new byte[64];
+        byte[] a = new byte[32];
+        byte[] b = new byte[32];
+        byte[] c = new byte[32];
+        for (int i = 0; i < 100; ++i) {
+            random.nextBytes(s);
+            random.nextBytes(a);
+            random.nextBytes(b);
+            random.nextBytes(c);
+            a[31] &= 0x0F;
+            b[31] &= 0x0F;
+            c[31] &= 0x0F;
+            BigInteger expected = new BigInteger(1, reverse(s)).mod(l);
+            assertEquals(expected, new BigInteger(1, reverse(spec.getScalarOps().reduce(s))));
+            expected = new BigInteger(1, reverse(a)).multiply(new BigInteger(1, reverse(b)))
+                    .add(new BigInteger(1, reverse(c))).mod(l);
+            assertEquals(expected, new BigInteger(1, reverse(spec.getScalarOps().multiplyAndAdd(a, b, c))));
+        }
+    }
+
+    @Test
+    public void addMultipleOfOrderMatchesScalar() {
+        Ed25519CurveParameterSpec spec = Ed25519.getSpec();
+        SecureRandom random = new SecureRandom();
+        byte[] hash = new byte[64];
+        for (int i = 0; i < 100; ++i) {
+            random.nextBytes(hash);
+            byte[] s = spec.getScalarOps().reduce(hash);
+            // Add l, 2l and 4l one bit at a time
+            Scalar expected = new Scalar(s);
+            Scalar order = new Scalar(Utils.hexToBytes("edd3f55c1a631258d69cf7a2def9de1400000000000000000000000000000010"));
+            for (int bit = 1; bit <= 4; bit <<= 1) {
+                Scalar tmp = new Scalar();
+                tmp.copy(order.cmov(tmp, (expected.getByte(0) & bit) != 0 ? -1L : 0L));
+                expected.copy(expected.add(tmp));
+                order.copy(order.dbl());
+            }
+            Spake2Context.addMultipleOfOrder(s);
+            assertArrayEquals(expected.getBytes(), s);
+            assertEquals(0, s[0] & 7);
+        }
+    }
+
+    @Test
+    public void fieldEncodingRoundTrip() {
+        Ed25519Field field = Ed25519.getSpec().getCurve().getField();
+        SecureRandom random = new SecureRandom();
+        byte[] bytes = new byte[32];
+        for (int i = 0; i < 100; ++i) {
+            random.nextBytes(bytes);
+            // Canonical encodings only, i.e. less than 2^255 - 19
+            bytes[31] &= 0x7F;
+            bytes[0] &= (byte) 0xEC;
+            assertArrayEquals(bytes, field.fromByteArray(bytes).toByteArray());
+        }
+    }
+
     @Test
     public void checkIfGeneratedValuesAreSameForN() {
         GroupElement[] ge = precomputeTable("edwards25519 point generation seed (N)");
@@ -201,6 +270,70 @@ public class Spake25519Test {
         assertArrayEquals(ge, Spake2Context.SPAKE_M_SMALL_PRECOMP);
     }
 
+    @Test
+    public void montgomeryLadderMatchesEdwards() {
+        Ed25519CurveParameterSpec spec = Ed25519.getSpec();
+        Curve curve = spec.getCurve();
+        MontgomeryLadder ladder = new MontgomeryLadder(curve);
+        SecureRandom random = new SecureRandom();
+        byte[] encoded = new byte[32];
+        byte[] privateKey = new byte[64];
+        for (int i = 0; i < 20; ++i) {
+            // Random points, including the ones with a small order component
+            GroupElement P;
+            do {
+                random.nextBytes(encoded);
+                P = curve.fromBytesNegateVarTime(encoded);
+            } while (P == null);
+            // Same as the ephemeral scalar, i.e. multiplied by the cofactor
+            random.nextBytes(privateKey);
+            byte[] a = new BigInteger(1, reverse(spec.getScalarOps().reduce(privateKey))).shiftLeft(3).toByteArray();
+            a = Arrays.copyOf(reverse(a), 32);
+
+            GroupElement PPrecomp = new GroupElement(curve, GroupElement.Representation.P3, P.getX(), P.getY(),
+                    P.getZ(), P.getT(), true, true);
+            assertArrayEquals(PPrecomp.scalarMultiply(a).toByteArray(), ladder.scalarMultiply(P, a));
+        }
+        // Neutral element and the point of order two
+        byte[] a = Utils.hexToBytes("4000000000000000000000000000000000000000000000000000000000000000");
+        GroupElement zero = curve.getZero(GroupElement.Representation.P3);
+        assertArrayEquals(zero.toByteArray(), ladder.scalarMultiply(zero, a));
+        GroupElement orderTwo = curve.fromBytesNegateVarTime(Utils.hexToBytes("ecffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f"));
+        assertArrayEquals(zero.toByteArray(), ladder.scalarMultiply(orderTwo, a));
+    }
+
+    @Test
+    public void montgomeryLadderExceptionalResults() {
+        Ed25519CurveParameterSpec spec = Ed25519.getSpec();
+        Curve curve = spec.getCurve();
+        MontgomeryLadder ladder = new MontgomeryLadder(curve);
+        BigInteger l = BigInteger.ONE.shiftLeft(252).add(new BigInteger("27742317777372353535851937790883648493"));
+        GroupElement B = spec.getB();
+        // a * B is the neutral element, i.e. z2 = 0 at the end of the ladder
+        byte[] a = toScalar(l.shiftLeft(3));
+        assertArrayEquals(curve.getZero(GroupElement.Representation.P3).toByteArray(), ladder.scalarMultiply(B, a));
+        // (a + 1) * B is the neutral element, i.e. z3 = 0 and a * B = -B, for a multiple of eight
+        BigInteger k = l.subtract(BigInteger.ONE).multiply(BigInteger.valueOf(8).modInverse(l)).mod(l);
+        a = toScalar(k.shiftLeft(3));
+        assertArrayEquals(B.scalarMultiply(toScalar(l.subtract(BigInteger.ONE))).toByteArray(),
+                ladder.scalarMultiply(B, a));
+    }
+
+    /**
+     * @return The 32 bytes little-endian encoding of {@code n}
+     */
+    private static byte[] toScalar(BigInteger n) {
+        return Arrays.copyOf(reverse(n.toByteArray()), 32);
+    }
+
+    private static byte[] reverse(byte[] bytes) {
+        byte[] reversed = new byte[bytes.length];
+        for (int i = 0; i < bytes.length; ++i) {
+            reversed[i] = bytes[bytes.length - 1 - i];
+        }
+        return reversed;
+    }
+
     @Test
     public void spake2() {
         for (int i = 0; i < 20; i++) {
@@ -211,6 +344,180 @@ public class Spake25519Test {
         }
     }
 
+    @Test
+    public void contextStore() {
+        byte[] password = "password".getBytes(StandardCharsets.UTF_8);
+        byte[] aliceName = "adb pair client\u0000".getBytes(StandardCharsets.UTF_8);
+        byte[] bobName = "adb pair server\u0000".getBytes(StandardCharsets.UTF_8);
+        Spake2ContextStore store = new Spake2ContextStore(2, 16);
+        for (int i = 0; i < 4; i++) {
+            long alice = store.allocate(Spake2Role.Alice, aliceName, bobName);
+            Spake2Context bob = new Spake2Context(Spake2Role.Bob, bobName, aliceName);
+            byte[] aliceMsg = store.generateMessage(alice, password);
+            byte[] bobMsg = bob.generateMessage(password);
+            assertArrayEquals(store.processMessage(alice, bobMsg), bob.processMessage(aliceMsg));
+            store.free(alice);
+        }
+        assertEquals(0, store.size());
+    }
+
+    @Test
+    public void contextStoreHandles() {
+        byte[] name = "name".getBytes(StandardCharsets.UTF_8);
+        Spake2ContextStore store = new Spake2ContextStore(2, 4);
+        long first = store.allocate(Spake2Role.Alice, name, name);
+        long second = store.allocate(Spake2Role.Bob, name, name);
+        assertNotEquals(first, second);
+        assertThrows(IllegalStateException.class, () -> store.allocate(Spake2Role.Alice, name, name));
+        store.free(first);
+        assertThrows(IllegalStateException.class, () -> store.free(first));
+        assertThrows(IllegalStateException.class, () -> store.processMessage(second, new byte[32]));
+        assertThrows(IllegalArgumentException.class, () -> store.allocate(Spake2Role.Alice, new byte[5], name));
+        // The slot is reused right away, but the stale handle doesn't reach the new context
+        long third = store.allocate(Spake2Role.Bob, name, name);
+        assertEquals((int) first, (int) third);
+        assertNotEquals(first, third);
+        assertThrows(IllegalStateException.class, () -> store.getMyRole(first));
+        assertThrows(IllegalStateException.class, () -> store.generateMessage(first, name));
+        assertEquals(Spake2Role.Bob, store.getMyRole(third));
+    }
+
+    @Test
+    public void contextFootprint() {
+        // The state of a context is a single array holding the secrets and both the names, see Spake2Benchmark for
+        // the heap usage of a live context
+        byte[] aliceName = "adb pair client\u0000".getBytes(StandardCharsets.UTF_8);
+        byte[] bobName = "adb pair server\u0000".getBytes(StandardCharsets.UTF_8);
+        Spake2Context context = new Spake2Context(Spake2Role.Alice, aliceName, bobName);
+        assertEquals(Spake2Context.SECRETS_SIZE + aliceName.length + bobName.length, context.getStateSize());
+        // A slot of the store holds a 16-byte header, the secrets and room for both the names, rounded up to 16 bytes
+        Spake2ContextStore store = new Spake2ContextStore(1000, 16);
+        assertEquals(16 + Spake2Context.SECRETS_SIZE + 2 * 16, store.getSlotSize());
+        assertEquals(0, store.getSlotSize() % 16);
+        assertEquals(16 + Spake2Context.SECRETS_SIZE + 2 * 16, new Spake2ContextStore(1000, 13).getSlotSize());
+    }
+
+    @Test
+    public void spake2Plus() {
+        byte[] password = "password".getBytes(StandardCharsets.UTF_8);
+        byte[] aliceName = "adb pair client\u0000".getBytes(StandardCharsets.UTF_8);
+        byte[] bobName = "adb pair server\u0000".getBytes(StandardCharsets.UTF_8);
+        // The server only keeps the record
+        byte[] record = Spake2PlusVerifier.fromPassword(password).toRecord();
+        assertEquals(Spake2PlusVerifier.RECORD_SIZE, record.length);
+        for (int i = 0; i < 4; i++) {
+            Spake2PlusVerifier verifier = Spake2PlusVerifier.fromRecord(ByteBuffer.wrap(record));
+            assertArrayEquals(record, verifier.toRecord());
+            Spake2PlusContext alice = new Spake2PlusContext(Spake2Role.Alice, aliceName, bobName);
+            Spake2PlusContext bob = new Spake2PlusContext(Spake2Role.Bob, bobName, aliceName);
+            byte[] aliceMsg = alice.generateMessage(password);
+            byte[] bobMsg = bob.generateMessage(verifier);
+            assertArrayEquals(alice.processMessage(bobMsg), bob.processMessage(aliceMsg));
+        }
+        // A corrupted point of the record is rejected
+        for (int off = 32; off < Spake2PlusVerifier.RECORD_SIZE; off += 96) {
+            byte[] corrupted = record.clone();
+            corrupted[off] ^= 1;
+            assertThrows(IllegalArgumentException.class, () -> Spake2PlusVerifier.fromRecord(ByteBuffer.wrap(corrupted)));
+        }
+
+        Spake2PlusContext alice = new Spake2PlusContext(Spake2Role.Alice, aliceName, bobName);
+        Spake2PlusContext bob = new Spake2PlusContext(Spake2Role.Bob, bobName, aliceName);
+        byte[] aliceMsg = alice.generateMessage("wrong password".getBytes(StandardCharsets.UTF_8));
+        byte[] bobMsg = bob.generateMessage(Spake2PlusVerifier.fromRecord(ByteBuffer.wrap(record)));
+        assertFalse(Arrays.equals(alice.processMessage(bobMsg), bob.processMessage(aliceMsg)));
+        assertThrows(IllegalStateException.class, () -> new Spake2PlusContext(Spake2Role.Bob, bobName, aliceName)
+                .generateMessage(password));
+    }
+
+    @Test
+    public void kernelProfiler() {
+        if (!KernelProfiler.ENABLED) {
+            assertThrows(IllegalStateException.class, KernelProfiler::start);
+            return;
+        }
+        byte[] password = "password".getBytes(StandardCharsets.UTF_8);
+        byte[] aliceName = "adb pair client\u0000".getBytes(StandardCharsets.UTF_8);
+        byte[] bobName = "adb pair server\u0000".getBytes(StandardCharsets.UTF_8);
+        Spake2Context alice = new Spake2Context(Spake2Role.Alice, aliceName, bobName);
+        Spake2Context bob = new Spake2Context(Spake2Role.Bob, bobName, aliceName);
+        byte[] bobMsg = bob.generateMessage(password);
+        KernelProfiler profiler = KernelProfiler.start();
+        alice.generateMessage(password);
+        alice.processMessage(bobMsg);
+        profiler.stop();
+        for (String phase : new String[]{"generateMessage", "processMessage"}) {
+            assertTrue(profiler.getCount(phase, KernelProfiler.Kernel.FIELD_MULTIPLY) > 0);
+            assertTrue(profiler.getCount(phase, KernelProfiler.Kernel.FIELD_SQUARE) > 0);
+            assertTrue(profiler.getCount(phase, KernelProfiler.Kernel.FIELD_INVERT) > 0);
+            assertTrue(profiler.getCount(phase, KernelProfiler.Kernel.TABLE_SELECT) > 0);
+            assertTrue(profiler.getCount(phase, KernelProfiler.Kernel.SHA512) > 0);
+        }
+        String folded = profiler.toFoldedStacks();
+        assertTrue(folded.contains("processMessage;field_multiply "));
+        // The kernels of an inversion are nested under it instead of being counted alongside it
+        assertTrue(folded.contains("processMessage;field_invert "));
+        assertTrue(folded.contains("processMessage;field_invert;field_square "));
+        assertEquals(0, profiler.getCount("processMessage;field_invert", KernelProfiler.Kernel.FIELD_INVERT));
+        // Only the current thread is profiled and only until stop()
+        long total = profiler.getTotals().get(KernelProfiler.Kernel.FIELD_MULTIPLY);
+        bob.processMessage(alice.getMyMsg());
+        assertEquals(total, (long) profiler.getTotals().get(KernelProfiler.Kernel.FIELD_MULTIPLY));
+    }
+
+    @Test
+    public void byteBuffers() {
+        byte[] password = "password".getBytes(StandardCharsets.UTF_8);
+        byte[] aliceName = "adb pair client\u0000".getBytes(StandardCharsets.UTF_8);
+        byte[] bobName = "adb pair server\u0000".getBytes(StandardCharsets.UTF_8);
+        // Direct buffers, and heap buffers which don't start at the beginning of their arrays
+        for (boolean direct : new boolean[]{true, false}) {
+            ByteBuffer io = direct ? ByteBuffer.allocateDirect(256) : ByteBuffer.wrap(new byte[264], 8, 256).slice();
+            Spake2Context alice = new Spake2Context(Spake2Role.Alice, aliceName, bobName);
+            Spake2Context bob = new Spake2Context(Spake2Role.Bob, bobName, aliceName);
+            io.put(password);
+            io.flip();
+            ByteBuffer aliceMsg = io.duplicate();
+            aliceMsg.clear();
+            aliceMsg.position(16);
+            alice.generateMessage(io, aliceMsg);
+            assertEquals(password.length, io.position());
+            assertEquals(16 + Spake2Context.MAX_MSG_SIZE, aliceMsg.position());
+            aliceMsg.flip();
+            aliceMsg.position(16);
+            assertEquals(ByteBuffer.wrap(alice.getMyMsg()), aliceMsg);
+
+            ByteBuffer bobMsg = ByteBuffer.wrap(bob.generateMessage(password));
+            ByteBuffer key = io.duplicate();
+            key.clear();
+            key.position(64);
+            alice.processMessage(bobMsg, key);
+            assertFalse(bobMsg.hasRemaining());
+            assertEquals(64 + Spake2Context.MAX_KEY_SIZE, key.position());
+            byte[] aliceKey = new byte[Spake2Context.MAX_KEY_SIZE];
+            key.position(64);
+            key.get(aliceKey);
+            assertArrayEquals(bob.processMessage(alice.getMyMsg()), aliceKey);
+        }
+
+        Spake2Context alice = new Spake2Context(Spake2Role.Alice, aliceName, bobName);
+        assertThrows(BufferOverflowException.class, () -> alice.generateMessage(ByteBuffer.wrap(password),
+                ByteBuffer.allocate(Spake2Context.MAX_MSG_SIZE - 1)));
+        alice.generateMessage(ByteBuffer.wrap(password), ByteBuffer.allocate(Spake2Context.MAX_MSG_SIZE));
+        assertThrows(BufferUnderflowException.class, () -> alice.processMessage(ByteBuffer.allocate(31),
+                ByteBuffer.allocate(Spake2Context.MAX_KEY_SIZE)));
+        assertThrows(ReadOnlyBufferException.class, () -> alice.processMessage(ByteBuffer.allocate(32),
+                ByteBuffer.allocate(Spake2Context.MAX_KEY_SIZE).asReadOnlyBuffer()));
+        // The state is checked before the arguments
+        assertThrows(IllegalStateException.class, () -> alice.generateMessage(ByteBuffer.wrap(password),
+                ByteBuffer.allocate(Spake2Context.MAX_MSG_SIZE - 1)));
+        Spake2Context bob = new Spake2Context(Spake2Role.Bob, bobName, aliceName);
+        assertThrows(IllegalStateException.class, () -> bob.processMessage(new byte[31]));
+        bob.destroy();
+        assertThrows(IllegalStateException.class, () -> bob.generateMessage(ByteBuffer.wrap(password),
+                ByteBuffer.allocate(Spake2Context.MAX_MSG_SIZE).asReadOnlyBuffer()));
+    }
+
     @Test
     public void oldAlice() {
         for (int i = 0; i < 20; i++) {
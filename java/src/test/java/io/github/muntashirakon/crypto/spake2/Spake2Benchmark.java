@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 Muntashir Al-Islam
+ *
+ * Licensed according to the LICENSE file in this repository.
+ */
+
+package io.github.muntashirakon.crypto.spake2;
+
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.security.SecureRandom;
+import java.util.Arrays;
+import java.util.HashSet;
+import java.util.Locale;
+import java.util.Set;
+
+import io.github.muntashirakon.crypto.ed25519.Curve;
+import io.github.muntashirakon.crypto.ed25519.Ed25519;
+import io.github.muntashirakon.crypto.ed25519.Ed25519CurveParameterSpec;
+import io.github.muntashirakon.crypto.ed25519.Ed25519Field;
+import io.github.muntashirakon.crypto.ed25519.Ed25519ScalarOps;
+import io.github.muntashirakon.crypto.ed25519.FieldElement;
+import io.github.muntashirakon.crypto.ed25519.GroupElement;
+import io.github.muntashirakon.crypto.ed25519.MontgomeryLadder;
+
+/**
+ * Micro-benchmarks, kept out of the unit tests since their results depend on the machine. Run them with
+ * {@code ./gradlew :java:benchmark}, or only some of them with e.g.
+ * {@code ./gradlew :java:benchmark -Pbenchmarks=ladder}.
+ * <p>
+ * Each benchmark is run once to warm up the JIT before it is timed, and prints the mean time per operation.
+ */
+public class Spake2Benchmark {
+    // Keeps the results alive so that the JIT can't drop the work
+    private static volatile Object sink;
+
+    private interface Operation {
+        Object run(int i);
+    }
+
+    public static void main(String[] args) {
+        Set<String> selected = new HashSet<>(Arrays.asList(args));
+        if (selected.isEmpty() || selected.contains("ladder")) {
+            ladder();
+        }
+        if (selected.isEmpty() || selected.contains("footprint")) {
+            footprint();
+        }
+        if (selected.isEmpty() || selected.contains("codec")) {
+            codec();
+        }
+    }
+
+    /**
+     * The DH step of {@link Spake2Context#processMessage(byte[])}: the x-only Montgomery ladder against multiplying a
+     * precomputed Edwards point, which is what it replaced.
+     */
+    static void ladder() {
+        Ed25519CurveParameterSpec spec = Ed25519.getSpec();
+        Curve curve = spec.getCurve();
+        MontgomeryLadder ladder = new MontgomeryLadder(curve);
+        SecureRandom random = new SecureRandom();
+        final int count = 64;
+        GroupElement[] points = new GroupElement[count];
+        byte[][] scalars = new byte[count][];
+        byte[] encoded = new byte[32];
+        byte[] privateKey = new byte[64];
+        for (int i = 0; i < count; ++i) {
+            do {
+                random.nextBytes(encoded);
+                points[i] = curve.fromBytesNegateVarTime(encoded);
+            } while (points[i] == null);
+            random.nextBytes(privateKey);
+            byte[] a = spec.getScalarOps().reduce(privateKey);
+            Spake2Context.leftShift3(a);
+            scalars[i] = a;
+        }
+        measure("ladder: Montgomery", 2000, i -> ladder.scalarMultiply(points[i % count], scalars[i % count]));
+        measure("ladder: Edwards, precomputed", 2000, i -> {
+            GroupElement P = points[i % count];
+            return new GroupElement(curve, GroupElement.Representation.P3, P.getX(), P.getY(), P.getZ(), P.getT(),
+                    true, true).scalarMultiply(scalars[i % count]).toByteArray();
+        });
+    }
+
+    /**
+     * Bytes per live context: the growth of the heap while keeping many {@link Spake2Context}s alive, and the size of a
+     * slot of the off-heap {@link Spake2ContextStore}.
+     */
+    static void footprint() {
+        final int count = 100_000;
+        byte[] aliceName = "adb pair client\u0000".getBytes(StandardCharsets.UTF_8);
+        byte[] bobName = "adb pair server\u0000".getBytes(StandardCharsets.UTF_8);
+        Spake2Context[] contexts = new Spake2Context[count];
+        long before = usedMemory();
+        for (int i = 0; i < count; ++i) {
+            contexts[i] = new Spake2Context(Spake2Role.Alice, aliceName, bobName);
+        }
+        long after = usedMemory();
+        sink = contexts;
+        System.out.printf(Locale.ROOT, "%-40s %12d bytes%n", "footprint: Spake2Context",
+                (after - before) / count);
+        Spake2ContextStore store = new Spake2ContextStore(count, Math.max(aliceName.length, bobName.length));
+        System.out.printf(Locale.ROOT, "%-40s %12d bytes%n", "footprint: Spake2ContextStore slot",
+                store.getSlotSize());
+    }
+
+    /**
+     * The little-endian loads and stores of the field element codec and the scalar operations.
+     */
+    static void codec() {
+        Ed25519CurveParameterSpec spec = Ed25519.getSpec();
+        Ed25519Field field = spec.getCurve().getField();
+        Ed25519ScalarOps scalarOps = spec.getScalarOps();
+        SecureRandom random = new SecureRandom();
+        final int count = 64;
+        byte[][] encoded = new byte[count][32];
+        byte[][] wide = new byte[count][64];
+        FieldElement[] elements = new FieldElement[count];
+        ByteBuffer direct = ByteBuffer.allocateDirect(count * 32);
+        for (int i = 0; i < count; ++i) {
+            random.nextBytes(encoded[i]);
+            encoded[i][31] &= 0x7F;
+            random.nextBytes(wide[i]);
+            elements[i] = field.fromByteArray(encoded[i]);
+            direct.put(encoded[i]);
+        }
+        byte[][] scalars = new byte[count][];
+        for (int i = 0; i < count; ++i) {
+            scalars[i] = scalarOps.reduce(wide[i]);
+        }
+        measure("codec: decode", 1_000_000, i -> field.fromByteArray(encoded[i % count]));
+        measure("codec: decode, direct buffer", 1_000_000, i -> field.fromByteBuffer(direct, (i % count) * 32));
+        measure("codec: encode", 1_000_000, i -> elements[i % count].toByteArray());
+        measure("codec: reduce", 200_000, i -> scalarOps.reduce(wide[i % count]));
+        measure("codec: multiplyAndAdd", 200_000, i -> scalarOps.multiplyAndAdd(scalars[i % count],
+                scalars[(i + 1) % count], scalars[(i + 2) % count]));
+    }
+
+    private static long usedMemory() {
+        Runtime runtime = Runtime.getRuntime();
+        for (int i = 0; i < 3; ++i) {
+            System.gc();
+        }
+        return runtime.totalMemory() - runtime.freeMemory();
+    }
+
+    private static void measure(String name, int iterations, Operation operation) {
+        for (int i = 0; i < iterations; ++i) {
+            sink = operation.run(i);
+        }
+        long start = System.nanoTime();
+        for (int i = 0; i < iterations; ++i) {
+            sink = operation.run(i);
+        }
+        long elapsed = System.nanoTime() - start;
+        System.out.printf(Locale.ROOT, "%-40s %12.1f ns/op%n", name, (double) elapsed / iterations);
+    }
+}